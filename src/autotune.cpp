@@ -0,0 +1,53 @@
+#include <mpi.h>
+#include <cstdlib>
+#include <string>
+#include "autotune.h"
+#include "spmv_kernel.h"
+#include "util.h"
+using namespace std;
+
+// Seconds per SpMV of the block, the first call is a warm up
+static double TimeBlock (const SparseMatrix &A, Vector &x, Vector &y, bool internal, double budget) {
+    if (internal) SpMVInternal(A, x, y);
+    else SpMVExternal(A, x, y);
+    int nLoop = 0;
+    double begin = MPI_Wtime(), elapsed = 0;
+    while (nLoop < AUTOTUNE_MINIMUM_LOOP || elapsed < budget) {
+        if (internal) SpMVInternal(A, x, y);
+        else SpMVExternal(A, x, y);
+        nLoop++;
+        elapsed = MPI_Wtime() - begin;
+    }
+    return elapsed / nLoop;
+}
+
+void AutotuneBlockFormat (SparseMatrix &A, Vector &x, Vector &y, bool internal) {
+    double budget = atof(GetEnvOption("SPMV_AUTOTUNE_SECOND", to_string(static_cast<long double>(AUTOTUNE_DEFAULT_SECOND))).c_str());
+    int &format = internal ? A.internalFormat : A.externalFormat;
+    int &schedule = internal ? A.internalSchedule : A.externalSchedule;
+    int bestFormat = format, bestSchedule = schedule;
+    double bestTime = TimeBlock(A, x, y, internal, budget);
+    DeleteBlockFormat(A, internal);
+    for (int f = 0; f < NUMBER_OF_FORMATS; f++) {
+        for (int s = 0; s < NUMBER_OF_SCHEDULES; s++) {
+            // CSR and merge path have their own partition of the rows
+            if ((f == FORMAT_CSR || f == FORMAT_MERGE) && s != SCHEDULE_STATIC) continue;
+            if (f == bestFormat && s == bestSchedule) continue;
+            format = f;
+            schedule = s;
+            CreateBlockFormat(A, internal);
+            // BCSR fell back to CSR
+            if (format != f) continue;
+            double time = TimeBlock(A, x, y, internal, budget);
+            DeleteBlockFormat(A, internal);
+            if (time < bestTime) {
+                bestTime = time;
+                bestFormat = f;
+                bestSchedule = s;
+            }
+        }
+    }
+    format = bestFormat;
+    schedule = bestSchedule;
+    CreateBlockFormat(A, internal);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "sparse_matrix.h"
+#include "vector.h"
+
+//------------------------------------------
+// Per-rank kernel autotuner
+//------------------------------------------
+// Every (format, schedule) candidate is built on the local block and timed for about
+// SPMV_AUTOTUNE_SECOND seconds, the fastest one is kept. The timing is local to the
+// rank (no communication), so the ranks may pick different kernels.
+#define AUTOTUNE_DEFAULT_SECOND     0.01
+#define AUTOTUNE_MINIMUM_LOOP       3
+
+// The block keeps its current format when nothing is faster
+void AutotuneBlockFormat (SparseMatrix &A, Vector &x, Vector &y, bool internal);
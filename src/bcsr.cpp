@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <vector>
+#include "bcsr.h"
+using namespace std;
+
+static const int blockSizes[][2] = {
+    {1, 2}, {1, 4}, {2, 1}, {2, 2}, {2, 4}, {3, 3}, {4, 1}, {4, 2}, {4, 4}, {6, 6}
+};
+static const int numberOfBlockSizes = sizeof(blockSizes) / sizeof(blockSizes[0]);
+
+bool IsSupportedBcsrBlockSize (int r, int c) {
+    for (int s = 0; s < numberOfBlockSizes; s++) {
+        if (blockSizes[s][0] == r && blockSizes[s][1] == c) return true;
+    }
+    return false;
+}
+
+// Sorted distinct aligned block columns of the rows [rowBegin, rowEnd)
+static void GetBlockKeys (int rowBegin, int rowEnd, const int *ptr, const int *idx, int c, vector<int> &keys) {
+    keys.clear();
+    for (int j = ptr[rowBegin]; j < ptr[rowEnd]; j++) keys.push_back(idx[j] / c);
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+}
+
+double EstimateBcsrFill (int nRow, const int *ptr, const int *idx, int r, int c) {
+    const int nBlockRow = (nRow + r - 1) / r;
+    const int stride = max(1, nBlockRow / BCSR_NUMBER_OF_SAMPLE_BLOCK_ROWS);
+    long long stored = 0, nonzeros = 0;
+    vector<int> keys;
+    for (int br = 0; br < nBlockRow; br += stride) {
+        const int rowBegin = br * r, rowEnd = min(nRow, rowBegin + r);
+        GetBlockKeys(rowBegin, rowEnd, ptr, idx, c, keys);
+        stored += (long long) keys.size() * r * c;
+        nonzeros += ptr[rowEnd] - ptr[rowBegin];
+    }
+    return nonzeros ? (double) stored / nonzeros : 1;
+}
+
+// CSR moves 8 + 4 bytes per nonzero, BCSR moves fill * 8 + 4 / (r * c) bytes
+// (the row pointers are ignored in both).
+void SelectBcsrBlockSize (int nRow, int nCol, const int *ptr, const int *idx, int &r, int &c) {
+    r = c = 1;
+    if (ptr[nRow] == 0) return;
+    double best = (8.0 + 4.0) * BCSR_MINIMUM_GAIN;
+    for (int s = 0; s < numberOfBlockSizes; s++) {
+        const int br = blockSizes[s][0], bc = blockSizes[s][1];
+        if (bc > nCol) continue;
+        double fill = EstimateBcsrFill(nRow, ptr, idx, br, bc);
+        double bytes = fill * (8.0 + 4.0 / (br * bc));
+        if (bytes < best) {
+            best = bytes;
+            r = br;
+            c = bc;
+        }
+    }
+}
+
+void CreateBcsrMatrix (BcsrMatrix &B, int nRow, int nCol, const int *ptr, const int *idx, const double *val, int r, int c) {
+    B.r = r;
+    B.c = c;
+    B.numberOfRows = nRow;
+    B.numberOfBlockRows = (nRow + r - 1) / r;
+    B.numberOfNonzeros = ptr[nRow];
+    B.blockPtr = new int[B.numberOfBlockRows + 1];
+    B.blockPtr[0] = 0;
+#pragma omp parallel
+    {
+        vector<int> keys;
+#pragma omp for schedule(static)
+        for (int br = 0; br < B.numberOfBlockRows; br++) {
+            GetBlockKeys(br * r, min(nRow, br * r + r), ptr, idx, c, keys);
+            B.blockPtr[br+1] = keys.size();
+        }
+    }
+    for (int br = 0; br < B.numberOfBlockRows; br++) B.blockPtr[br+1] += B.blockPtr[br];
+    const int nBlock = B.blockPtr[B.numberOfBlockRows];
+    B.numberOfStoredElements = (long long) nBlock * r * c;
+    B.blockCol = new int[nBlock];
+    B.val = new double[B.numberOfStoredElements];
+#pragma omp parallel
+    {
+        vector<int> keys;
+#pragma omp for schedule(static)
+        for (int br = 0; br < B.numberOfBlockRows; br++) {
+            const int rowBegin = br * r, rowEnd = min(nRow, rowBegin + r);
+            GetBlockKeys(rowBegin, rowEnd, ptr, idx, c, keys);
+            const int first = B.blockPtr[br];
+            fill(B.val + (long long) first * r * c, B.val + (long long) (first + keys.size()) * r * c, 0);
+            for (size_t k = 0; k < keys.size(); k++) B.blockCol[first + k] = min(keys[k] * c, nCol - c);
+            for (int i = rowBegin; i < rowEnd; i++) {
+                for (int j = ptr[i]; j < ptr[i+1]; j++) {
+                    const int k = first + (lower_bound(keys.begin(), keys.end(), idx[j] / c) - keys.begin());
+                    B.val[(long long) k * r * c + (i - rowBegin) * c + (idx[j] - B.blockCol[k])] += val[j];
+                }
+            }
+        }
+    }
+}
+
+void DeleteBcsrMatrix (BcsrMatrix &B) {
+    delete [] B.blockPtr;
+    delete [] B.blockCol;
+    delete [] B.val;
+    B.blockPtr = B.blockCol = NULL;
+    B.val = NULL;
+}
+
+// R and C are compile time constants, so the block loops are fully unrolled
+// and the R partial sums are kept in registers.
+template<int R, int C>
+static void BcsrKernel (const BcsrMatrix &B, const double *x, double *y, bool accumulate) {
+    const int nFullBlockRow = B.numberOfRows / R;
+#pragma omp parallel for schedule(runtime)
+    for (int br = 0; br < B.numberOfBlockRows; br++) {
+        double sum[R];
+        for (int i = 0; i < R; i++) sum[i] = 0;
+        for (int k = B.blockPtr[br]; k < B.blockPtr[br+1]; k++) {
+            const double *v = B.val + (long long) k * R * C;
+            const double *xb = x + B.blockCol[k];
+            for (int i = 0; i < R; i++) {
+                for (int j = 0; j < C; j++) sum[i] += v[i * C + j] * xb[j];
+            }
+        }
+        // the last block row may be partial
+        const int n = br < nFullBlockRow ? R : B.numberOfRows - br * R;
+        double *yb = y + br * R;
+        if (accumulate) {
+            for (int i = 0; i < n; i++) yb[i] += sum[i];
+        } else {
+            for (int i = 0; i < n; i++) yb[i] = sum[i];
+        }
+    }
+}
+
+void BcsrMV (const BcsrMatrix &B, const double *x, double *y, bool accumulate) {
+#define BCSR_CASE(R, C) if (B.r == R && B.c == C) { BcsrKernel<R, C>(B, x, y, accumulate); return; }
+    BCSR_CASE(1, 2) BCSR_CASE(1, 4)
+    BCSR_CASE(2, 1) BCSR_CASE(2, 2) BCSR_CASE(2, 4)
+    BCSR_CASE(3, 3)
+    BCSR_CASE(4, 1) BCSR_CASE(4, 2) BCSR_CASE(4, 4)
+    BCSR_CASE(6, 6)
+#undef BCSR_CASE
+}
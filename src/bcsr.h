@@ -0,0 +1,33 @@
+#pragma once
+
+//------------------------------------------
+// Register blocked CSR (BCSR)
+//------------------------------------------
+// Nonzeros are grouped into dense r x c blocks (row major, explicit zeros as fill).
+// Block row br covers the rows [br * r, br * r + r), a block starts at column blockCol[k].
+// Blocks are aligned to multiples of c, except the ones which would run past the last
+// column: they are shifted left so that x is never read out of [0, nCol).
+#define BCSR_NUMBER_OF_SAMPLE_BLOCK_ROWS    2048
+// A block size is used only when it is expected to move this much less data than CSR
+#define BCSR_MINIMUM_GAIN                   0.9
+
+struct BcsrMatrix {
+    int r, c;
+    int numberOfRows;
+    int numberOfBlockRows;
+    long long numberOfNonzeros;
+    long long numberOfStoredElements;   // including the fill
+    int *blockPtr;                      // [numberOfBlockRows + 1]
+    int *blockCol;
+    double *val;                        // [r * c] per block
+};
+
+// Average number of stored elements per nonzero, estimated from sampled block rows
+double EstimateBcsrFill (int nRow, const int *ptr, const int *idx, int r, int c);
+// The block size which minimizes the estimated bytes per nonzero, r = c = 1 if CSR is better
+void SelectBcsrBlockSize (int nRow, int nCol, const int *ptr, const int *idx, int &r, int &c);
+bool IsSupportedBcsrBlockSize (int r, int c);
+void CreateBcsrMatrix (BcsrMatrix &B, int nRow, int nCol, const int *ptr, const int *idx, const double *val, int r, int c);
+void DeleteBcsrMatrix (BcsrMatrix &B);
+// y = B x (accumulate == false) or y += B x (accumulate == true)
+void BcsrMV (const BcsrMatrix &B, const double *x, double *y, bool accumulate);
@@ -0,0 +1,62 @@
+#pragma once
+#include <stdint.h>
+
+//------------------------------------------
+// Binary partition file (*.bpart)
+//------------------------------------------
+// Same content as the text *.part file, but every array is stored as a
+// 64 byte aligned section so that the loader can mmap the file and use the
+// sections in place. Indices in the SubMatrix sections are already local.
+// A file without the communication plan (hasCommunication == 0) stores only the local rows
+// in LOCAL_TO_GLOBAL and global column indices in EXTERNAL_IDX, the plan is built at runtime.
+// A symmetric matrix (symmetric == 1) stores only the lower triangle, globalNumberOfNonzeros
+// counts both triangles.
+#define BINARY_PART_MAGIC           "SPMVPART"
+#define BINARY_PART_VERSION         4
+#define BINARY_PART_ALIGNMENT       64
+#define BINARY_PART_NAME_LENGTH     256
+
+enum BinaryPartSection {
+    SECTION_LOCAL_TO_GLOBAL = 0,    // int [totalNumberOfUsedCols]
+    SECTION_INTERNAL_PTR,           // int [localNumberOfRows + 1]
+    SECTION_INTERNAL_IDX,           // int [numberOfInternalNonzeros]
+    SECTION_INTERNAL_VAL,           // double [numberOfInternalNonzeros]
+    SECTION_EXTERNAL_PTR,           // int [localNumberOfRows + 1]
+    SECTION_EXTERNAL_IDX,           // int [numberOfExternalNonzeros]
+    SECTION_EXTERNAL_VAL,           // double [numberOfExternalNonzeros]
+    SECTION_SEND_NEIGHBORS,         // int [numberOfSendNeighbors]
+    SECTION_SEND_LENGTH,            // int [numberOfSendNeighbors]
+    SECTION_LOCAL_INDEX_OF_SEND,    // int [totalNumberOfSend]
+    SECTION_RECV_NEIGHBORS,         // int [numberOfRecvNeighbors]
+    SECTION_RECV_LENGTH,            // int [numberOfRecvNeighbors]
+    SECTION_LOCAL_INDEX_OF_RECV,    // int [totalNumberOfRecv]
+    NUMBER_OF_SECTIONS
+};
+
+struct BinaryPartHeader {
+    char magic[8];
+    int32_t version;
+    int32_t headerSize;
+    int64_t globalNumberOfRows;
+    int64_t globalNumberOfCols;
+    int64_t globalNumberOfNonzeros;
+    int32_t numberOfParts;
+    int32_t partId;
+    int32_t hasCommunication;
+    int32_t symmetric;
+    int64_t localNumberOfRows;
+    int64_t numberOfInternalNonzeros;
+    int64_t numberOfExternalNonzeros;
+    int64_t totalNumberOfUsedCols;
+    int64_t numberOfSendNeighbors;
+    int64_t totalNumberOfSend;
+    int64_t numberOfRecvNeighbors;
+    int64_t totalNumberOfRecv;
+    char matrixName[BINARY_PART_NAME_LENGTH];
+    int64_t sectionOffset[NUMBER_OF_SECTIONS];  // bytes from the beginning of the file
+    int64_t sectionLength[NUMBER_OF_SECTIONS];  // bytes
+};
+
+inline int64_t AlignBinaryPartOffset (int64_t offset) {
+    return (offset + BINARY_PART_ALIGNMENT - 1) / BINARY_PART_ALIGNMENT * BINARY_PART_ALIGNMENT;
+}
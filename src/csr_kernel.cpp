@@ -0,0 +1,87 @@
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#include "csr_kernel.h"
+using namespace std;
+
+// Rows shorter than this are summed by the unrolled scalar loop, gathers do not pay off
+#define CSR_SIMD_MINIMUM_ROW_LENGTH  16
+
+static inline double RowSum (int begin, int end, const int *idx, const double *val, const double *x) {
+    int j = begin;
+    double sum = 0;
+    if (end - begin >= CSR_SIMD_MINIMUM_ROW_LENGTH) {
+#if defined(__AVX512F__)
+        __m512d sum0 = _mm512_setzero_pd(), sum1 = _mm512_setzero_pd();
+        for (; j + 16 <= end; j += 16) {
+            __m512d x0 = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, _mm256_loadu_si256((const __m256i *) (idx + j)), x, 8);
+            __m512d x1 = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, _mm256_loadu_si256((const __m256i *) (idx + j + 8)), x, 8);
+            sum0 = _mm512_fmadd_pd(_mm512_loadu_pd(val + j), x0, sum0);
+            sum1 = _mm512_fmadd_pd(_mm512_loadu_pd(val + j + 8), x1, sum1);
+        }
+        if (j + 8 <= end) {
+            __m512d x0 = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, _mm256_loadu_si256((const __m256i *) (idx + j)), x, 8);
+            sum0 = _mm512_fmadd_pd(_mm512_loadu_pd(val + j), x0, sum0);
+            j += 8;
+        }
+        double partial[8];
+        _mm512_storeu_pd(partial, _mm512_add_pd(sum0, sum1));
+        sum = ((partial[0] + partial[1]) + (partial[2] + partial[3])) + ((partial[4] + partial[5]) + (partial[6] + partial[7]));
+#elif defined(__AVX2__)
+        __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+        for (; j + 8 <= end; j += 8) {
+            __m256d x0 = _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i *) (idx + j)), 8);
+            __m256d x1 = _mm256_i32gather_pd(x, _mm_loadu_si128((const __m128i *) (idx + j + 4)), 8);
+#ifdef __FMA__
+            sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(val + j), x0, sum0);
+            sum1 = _mm256_fmadd_pd(_mm256_loadu_pd(val + j + 4), x1, sum1);
+#else
+            sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(val + j), x0));
+            sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(val + j + 4), x1));
+#endif
+        }
+        __m256d s = _mm256_add_pd(sum0, sum1);
+        __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s), _mm256_extractf128_pd(s, 1));
+        sum = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+#endif
+    }
+    // four independent partial sums
+    double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (; j + 4 <= end; j += 4) {
+        s0 += val[j] * x[idx[j]];
+        s1 += val[j+1] * x[idx[j+1]];
+        s2 += val[j+2] * x[idx[j+2]];
+        s3 += val[j+3] * x[idx[j+3]];
+    }
+    for (; j < end; j++) s0 += val[j] * x[idx[j]];
+    return sum + ((s0 + s1) + (s2 + s3));
+}
+
+// rows [GetCsrThreadRowBegin(t), GetCsrThreadRowBegin(t + 1)) hold about nnz / nThread nonzeros
+int GetCsrThreadRowBegin (int nRow, const int *ptr, int t, int nThread) {
+    if (t == 0) return 0;
+    if (t == nThread) return nRow;
+    return lower_bound(ptr, ptr + nRow + 1, (int) ((long long) ptr[nRow] * t / nThread)) - ptr;
+}
+
+void CsrMV (int nRow, const int *ptr, const int *idx, const double *val, double alpha, const double *x, double beta, double *y) {
+#pragma omp parallel
+    {
+#ifdef _OPENMP
+        const int t = omp_get_thread_num(), nThread = omp_get_num_threads();
+#else
+        const int t = 0, nThread = 1;
+#endif
+        const int rowBegin = GetCsrThreadRowBegin(nRow, ptr, t, nThread);
+        const int rowEnd = GetCsrThreadRowBegin(nRow, ptr, t + 1, nThread);
+        if (beta == 0) {
+            for (int i = rowBegin; i < rowEnd; i++) y[i] = alpha * RowSum(ptr[i], ptr[i+1], idx, val, x);
+        } else {
+            for (int i = rowBegin; i < rowEnd; i++) y[i] = alpha * RowSum(ptr[i], ptr[i+1], idx, val, x) + beta * y[i];
+        }
+    }
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+//------------------------------------------
+// Portable CSR kernel (the MY_CSRMV backend)
+//------------------------------------------
+// y = alpha A x + beta y (y is not read when beta == 0).
+// The rows are split among the threads by nonzeros and summed in registers: long rows
+// with AVX-512 / AVX2 gathers (two accumulators), the rest by a loop unrolled by four.
+void CsrMV (int nRow, const int *ptr, const int *idx, const double *val, double alpha, const double *x, double beta, double *y);
+// First row of the thread t of nThread in CsrMV, the loader places the rows by the same split
+int GetCsrThreadRowBegin (int nRow, const int *ptr, int t, int nThread);
@@ -0,0 +1,37 @@
+#include <algorithm>
+#include "dcsr.h"
+using namespace std;
+
+void CreateDcsrMatrix (DcsrMatrix &D, int nRow, const int *ptr) {
+    D.numberOfRows = nRow;
+    D.numberOfNonzeros = ptr[nRow];
+    D.numberOfNonEmptyRows = 0;
+    for (int i = 0; i < nRow; i++) {
+        if (ptr[i+1] != ptr[i]) D.numberOfNonEmptyRows++;
+    }
+    D.rowIdx = new int[D.numberOfNonEmptyRows];
+    D.rowPtr = new int[D.numberOfNonEmptyRows + 1];
+    int k = 0;
+    for (int i = 0; i < nRow; i++) {
+        if (ptr[i+1] == ptr[i]) continue;
+        D.rowIdx[k] = i;
+        D.rowPtr[k++] = ptr[i];
+    }
+    D.rowPtr[k] = ptr[nRow];
+}
+
+void DeleteDcsrMatrix (DcsrMatrix &D) {
+    delete [] D.rowIdx;
+    delete [] D.rowPtr;
+    D.rowIdx = D.rowPtr = NULL;
+}
+
+void DcsrMV (const DcsrMatrix &D, const int *idx, const double *val, const double *x, double *y, bool accumulate) {
+    if (!accumulate) fill(y, y + D.numberOfRows, 0);
+#pragma omp parallel for schedule(runtime)
+    for (int k = 0; k < D.numberOfNonEmptyRows; k++) {
+        double sum = 0;
+        for (int j = D.rowPtr[k]; j < D.rowPtr[k+1]; j++) sum += val[j] * x[idx[j]];
+        y[D.rowIdx[k]] += sum;
+    }
+}
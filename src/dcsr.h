@@ -0,0 +1,21 @@
+#pragma once
+
+//------------------------------------------
+// Doubly compressed CSR (DCSR)
+//------------------------------------------
+// Only the rows with nonzeros are kept: the k-th of them is the local row rowIdx[k],
+// its nonzeros are [rowPtr[k], rowPtr[k+1]) of the idx/val arrays of the CSR block.
+// Meant for the external block, where most rows have no remote column.
+struct DcsrMatrix {
+    int numberOfRows;
+    int numberOfNonEmptyRows;
+    long long numberOfNonzeros;
+    int *rowIdx;        // [numberOfNonEmptyRows]
+    int *rowPtr;        // [numberOfNonEmptyRows + 1]
+};
+
+void CreateDcsrMatrix (DcsrMatrix &D, int nRow, const int *ptr);
+void DeleteDcsrMatrix (DcsrMatrix &D);
+// y = A x (accumulate == false) or y += A x (accumulate == true), only the non-empty
+// rows are read and written when accumulating
+void DcsrMV (const DcsrMatrix &D, const int *idx, const double *val, const double *x, double *y, bool accumulate);
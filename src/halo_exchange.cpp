@@ -0,0 +1,421 @@
+#include <mpi.h>
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+#include <vector>
+#include "halo_exchange.h"
+using namespace std;
+
+static const char *haloMethodNames[] = {"p2p", "neighbor", "rma"};
+static const char *packMethodNames[] = {"buffer", "datatype"};
+static const int numberOfPackMethods = sizeof(packMethodNames) / sizeof(packMethodNames[0]);
+
+const char* GetHaloMethodName (int method) {
+    return haloMethodNames[method];
+}
+
+int GetHaloMethod (const string &name) {
+    for (int m = 0; m < NUMBER_OF_HALO_METHODS; m++) {
+        if (name == haloMethodNames[m]) return m;
+    }
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) cerr << "Unknown halo exchange : " << name << endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+    return HALO_P2P;
+}
+
+const char* GetPackMethodName (int packing) {
+    return packMethodNames[packing];
+}
+
+int GetPackMethod (const string &name) {
+    for (int p = 0; p < numberOfPackMethods; p++) {
+        if (name == packMethodNames[p]) return p;
+    }
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) cerr << "Unknown packing : " << name << endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+    return PACK_BUFFER;
+}
+
+// One double at each local index of the send list of the neighbor
+static void CreateSendTypes (const SparseMatrix &A, HaloExchange &halo) {
+    halo.sendTypes = new MPI_Datatype[A.numberOfSendNeighbors];
+    for (int i = 0, offset = 0; i < A.numberOfSendNeighbors; offset += A.sendLength[i++]) {
+        MPI_Type_create_indexed_block(A.sendLength[i], 1, A.localIndexOfSend + offset, MPI_DOUBLE, &halo.sendTypes[i]);
+        MPI_Type_commit(&halo.sendTypes[i]);
+    }
+}
+
+static void FreeSendTypes (const SparseMatrix &A, HaloExchange &halo) {
+    if (!halo.sendTypes) return;
+    for (int i = 0; i < A.numberOfSendNeighbors; i++) MPI_Type_free(&halo.sendTypes[i]);
+    delete [] halo.sendTypes;
+    halo.sendTypes = NULL;
+}
+
+// The consecutive local rows at the beginning of every send list, the receivers get the lengths
+static void CreateContiguousSends (const SparseMatrix &A, HaloExchange &halo) {
+    halo.sendContiguous = new int[A.numberOfSendNeighbors];
+    halo.recvContiguous = new int[A.numberOfRecvNeighbors];
+    vector<int> packed;
+    for (int i = 0, offset = 0; i < A.numberOfSendNeighbors; offset += A.sendLength[i++]) {
+        const int *index = A.localIndexOfSend + offset;
+        int n = 1;
+        while (n < A.sendLength[i] && index[n] == index[0] + n) n++;
+        halo.sendContiguous[i] = n == A.sendLength[i] || n >= HALO_MINIMUM_CONTIGUOUS_SEND ? n : 0;
+        for (int j = halo.sendContiguous[i]; j < A.sendLength[i]; j++) packed.push_back(offset + j);
+    }
+    halo.numberOfPackedSend = packed.size();
+    if (halo.numberOfPackedSend < A.totalNumberOfSend) {
+        halo.packedSend = new int[packed.size()];
+        copy(packed.begin(), packed.end(), halo.packedSend);
+    }
+
+    vector<MPI_Request> requests(A.numberOfSendNeighbors + A.numberOfRecvNeighbors);
+    for (int i = 0; i < A.numberOfSendNeighbors; i++) {
+        MPI_Isend(&halo.sendContiguous[i], 1, MPI_INT, A.sendNeighbors[i], HALO_SETUP_TAG, MPI_COMM_WORLD, &requests[i]);
+    }
+    for (int i = 0; i < A.numberOfRecvNeighbors; i++) {
+        MPI_Irecv(&halo.recvContiguous[i], 1, MPI_INT, A.recvNeighbors[i], HALO_SETUP_TAG, MPI_COMM_WORLD, &requests[A.numberOfSendNeighbors + i]);
+    }
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+static void FreeContiguousSends (HaloExchange &halo) {
+    delete [] halo.sendContiguous;
+    delete [] halo.recvContiguous;
+    delete [] halo.packedSend;
+    halo.sendContiguous = halo.recvContiguous = halo.packedSend = NULL;
+}
+
+// The groups and the offsets of the send neighbors : every rank tells its recv neighbors
+// where their values start in its halo region (the same in the window of every vector)
+static void CreateRmaTargets (const SparseMatrix &A, HaloExchange &halo) {
+    MPI_Group world;
+    MPI_Comm_group(MPI_COMM_WORLD, &world);
+    MPI_Group_incl(world, A.numberOfSendNeighbors, A.sendNeighbors, &halo.accessGroup);
+    MPI_Group_incl(world, A.numberOfRecvNeighbors, A.recvNeighbors, &halo.exposureGroup);
+    MPI_Group_free(&world);
+
+    halo.targetDispl = new int[A.numberOfSendNeighbors];
+    vector<int> recvDispl(A.numberOfRecvNeighbors);
+    vector<MPI_Request> requests(A.numberOfRecvNeighbors + A.numberOfSendNeighbors);
+    for (int i = 0, offset = 0; i < A.numberOfRecvNeighbors; offset += A.recvLength[i++]) {
+        recvDispl[i] = offset;
+        MPI_Isend(&recvDispl[i], 1, MPI_INT, A.recvNeighbors[i], HALO_SETUP_TAG, MPI_COMM_WORLD, &requests[i]);
+    }
+    for (int i = 0; i < A.numberOfSendNeighbors; i++) {
+        MPI_Irecv(&halo.targetDispl[i], 1, MPI_INT, A.sendNeighbors[i], HALO_SETUP_TAG, MPI_COMM_WORLD, &requests[A.numberOfRecvNeighbors + i]);
+    }
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+}
+
+void CreateHaloExchange (SparseMatrix &A, int method, int packing, bool reorderRanks) {
+    HaloExchange &halo = *(A.halo = new HaloExchange);
+    halo.method = method;
+    halo.numberOfForwardBindings = 0;
+    halo.numberOfReverseBindings = 0;
+    halo.active = NULL;
+    halo.packing = packing;
+    halo.sendTypes = NULL;
+    halo.sendContiguous = halo.recvContiguous = halo.packedSend = NULL;
+    halo.numberOfPackedSend = packing == PACK_BUFFER ? A.totalNumberOfSend : 0;
+    halo.graphComm = MPI_COMM_NULL;
+    halo.rankReordered = false;
+    halo.sendDispl = halo.recvDispl = NULL;
+    halo.neighborRequest = MPI_REQUEST_NULL;
+    halo.sendCounts = NULL;
+    halo.sendBytes = halo.recvBytes = NULL;
+    halo.recvTypes = NULL;
+    halo.rmaActive = NULL;
+    halo.accessGroup = halo.exposureGroup = MPI_GROUP_NULL;
+    halo.targetDispl = NULL;
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    // a single rank has nothing to exchange (and some MPI libraries have no window for it)
+    if (method == HALO_RMA && size == 1) halo.method = HALO_P2P;
+    if (halo.method == HALO_RMA) CreateRmaTargets(A, halo);
+    if (packing == PACK_DATATYPE) CreateSendTypes(A, halo);
+    if (packing == PACK_BUFFER && halo.method != HALO_NEIGHBOR) CreateContiguousSends(A, halo);
+    if (method != HALO_NEIGHBOR) return;
+    MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+            A.numberOfRecvNeighbors, A.recvNeighbors, MPI_UNWEIGHTED,
+            A.numberOfSendNeighbors, A.sendNeighbors, MPI_UNWEIGHTED,
+            MPI_INFO_NULL, reorderRanks, &halo.graphComm);
+    int rank, graphRank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_rank(halo.graphComm, &graphRank);
+    halo.rankReordered = rank != graphRank;
+    halo.sendDispl = new int[A.numberOfSendNeighbors];
+    halo.recvDispl = new int[A.numberOfRecvNeighbors];
+    for (int i = 0, offset = 0; i < A.numberOfSendNeighbors; offset += A.sendLength[i++]) halo.sendDispl[i] = offset;
+    for (int i = 0, offset = 0; i < A.numberOfRecvNeighbors; offset += A.recvLength[i++]) halo.recvDispl[i] = offset;
+    if (packing != PACK_DATATYPE) return;
+    // MPI_Ineighbor_alltoallw : a type per neighbor and displacements in bytes
+    halo.sendCounts = new int[A.numberOfSendNeighbors];
+    halo.sendBytes = new MPI_Aint[A.numberOfSendNeighbors];
+    halo.recvBytes = new MPI_Aint[A.numberOfRecvNeighbors];
+    halo.recvTypes = new MPI_Datatype[A.numberOfRecvNeighbors];
+    for (int i = 0; i < A.numberOfSendNeighbors; i++) {
+        halo.sendCounts[i] = 1;
+        halo.sendBytes[i] = 0;
+    }
+    for (int i = 0; i < A.numberOfRecvNeighbors; i++) {
+        halo.recvBytes[i] = (MPI_Aint) halo.recvDispl[i] * sizeof(double);
+        halo.recvTypes[i] = MPI_DOUBLE;
+    }
+}
+
+// Collective for a binding with a window
+static void FreeBinding (HaloBinding &binding) {
+    for (int i = 0; i < binding.numberOfRecv + binding.numberOfSend; i++) MPI_Request_free(&binding.requests[i]);
+    delete [] binding.requests;
+    if (binding.window != MPI_WIN_NULL) MPI_Win_free(&binding.window);
+}
+
+void DeleteHaloExchange (SparseMatrix &A) {
+    if (!A.halo) return;
+    for (int b = 0; b < A.halo->numberOfForwardBindings; b++) FreeBinding(A.halo->forward[b]);
+    for (int b = 0; b < A.halo->numberOfReverseBindings; b++) FreeBinding(A.halo->reverse[b]);
+    if (A.halo->graphComm != MPI_COMM_NULL) MPI_Comm_free(&A.halo->graphComm);
+    delete [] A.halo->sendDispl;
+    delete [] A.halo->recvDispl;
+    if (A.halo->accessGroup != MPI_GROUP_NULL) {
+        MPI_Group_free(&A.halo->accessGroup);
+        MPI_Group_free(&A.halo->exposureGroup);
+    }
+    delete [] A.halo->targetDispl;
+    FreeSendTypes(A, *A.halo);
+    FreeContiguousSends(*A.halo);
+    delete [] A.halo->sendCounts;
+    delete [] A.halo->sendBytes;
+    delete [] A.halo->recvBytes;
+    delete [] A.halo->recvTypes;
+    delete A.halo;
+    A.halo = NULL;
+}
+
+void UpdateHaloSendIndices (SparseMatrix &A) {
+    HaloExchange &halo = *A.halo;
+    // the forward bindings send with the old types or ranges
+    for (int b = 0; b < halo.numberOfForwardBindings; b++) FreeBinding(halo.forward[b]);
+    halo.numberOfForwardBindings = 0;
+    if (halo.sendTypes) {
+        FreeSendTypes(A, halo);
+        CreateSendTypes(A, halo);
+    }
+    if (halo.sendContiguous) {
+        FreeContiguousSends(halo);
+        CreateContiguousSends(A, halo);
+    }
+}
+
+void PackHaloSend (const SparseMatrix &A, const double *x) {
+    const HaloExchange &halo = *A.halo;
+    double *sendBuffer = A.sendBuffer;
+    if (halo.packing != PACK_BUFFER) return;
+    if (!halo.packedSend) {
+#pragma omp parallel for
+        for (int i = 0; i < A.totalNumberOfSend; i++) sendBuffer[i] = x[A.localIndexOfSend[i]];
+        return;
+    }
+    const int *packed = halo.packedSend;
+#pragma omp parallel for
+    for (int k = 0; k < halo.numberOfPackedSend; k++) sendBuffer[packed[k]] = x[A.localIndexOfSend[packed[k]]];
+}
+
+// Receives into recvBuffer from the recv side, sends from sendBuffer to the send side
+static void InitBinding (HaloBinding &binding, const double *buffer, int tag,
+        int nRecvNeighbor, const int *recvNeighbors, const int *recvLength, double *recvBuffer,
+        int nSendNeighbor, const int *sendNeighbors, const int *sendLength, const double *sendBuffer) {
+    binding.buffer = buffer;
+    binding.numberOfRecv = nRecvNeighbor;
+    binding.numberOfSend = nSendNeighbor;
+    binding.requests = new MPI_Request[nRecvNeighbor + nSendNeighbor];
+    binding.window = MPI_WIN_NULL;
+    for (int i = 0; i < nRecvNeighbor; i++) {
+        MPI_Recv_init(recvBuffer, recvLength[i], MPI_DOUBLE, recvNeighbors[i], tag, MPI_COMM_WORLD, &binding.requests[i]);
+        recvBuffer += recvLength[i];
+    }
+    for (int i = 0; i < nSendNeighbor; i++) {
+        MPI_Send_init((void *) sendBuffer, sendLength[i], MPI_DOUBLE, sendNeighbors[i], tag, MPI_COMM_WORLD, &binding.requests[nRecvNeighbor + i]);
+        sendBuffer += sendLength[i];
+    }
+}
+
+// The forward exchange of x : a datatype over x for every send neighbor, or the contiguous
+// range straight from x (HALO_CONTIGUOUS_TAG) and the rest from A.sendBuffer. A neighbor
+// may take two requests on each side.
+static void InitForwardBinding (const SparseMatrix &A, const HaloExchange &halo, HaloBinding &binding, double *x) {
+    binding.buffer = x;
+    binding.requests = new MPI_Request[2 * (A.numberOfRecvNeighbors + A.numberOfSendNeighbors)];
+    binding.window = MPI_WIN_NULL;
+    int n = 0;
+    double *recvBuffer = x + A.localNumberOfRows;
+    for (int i = 0; i < A.numberOfRecvNeighbors; recvBuffer += A.recvLength[i++]) {
+        const int contiguous = halo.recvContiguous ? halo.recvContiguous[i] : 0;
+        if (contiguous) {
+            MPI_Recv_init(recvBuffer, contiguous, MPI_DOUBLE, A.recvNeighbors[i], HALO_CONTIGUOUS_TAG, MPI_COMM_WORLD, &binding.requests[n++]);
+        }
+        if (contiguous < A.recvLength[i]) {
+            MPI_Recv_init(recvBuffer + contiguous, A.recvLength[i] - contiguous, MPI_DOUBLE, A.recvNeighbors[i], HALO_FORWARD_TAG, MPI_COMM_WORLD, &binding.requests[n++]);
+        }
+    }
+    binding.numberOfRecv = n;
+    for (int i = 0, offset = 0; i < A.numberOfSendNeighbors; offset += A.sendLength[i++]) {
+        if (halo.sendTypes) {
+            MPI_Send_init(x, 1, halo.sendTypes[i], A.sendNeighbors[i], HALO_FORWARD_TAG, MPI_COMM_WORLD, &binding.requests[n++]);
+            continue;
+        }
+        const int contiguous = halo.sendContiguous ? halo.sendContiguous[i] : 0;
+        if (contiguous) {
+            MPI_Send_init(x + A.localIndexOfSend[offset], contiguous, MPI_DOUBLE, A.sendNeighbors[i], HALO_CONTIGUOUS_TAG, MPI_COMM_WORLD, &binding.requests[n++]);
+        }
+        if (contiguous < A.sendLength[i]) {
+            MPI_Send_init(A.sendBuffer + offset + contiguous, A.sendLength[i] - contiguous, MPI_DOUBLE, A.sendNeighbors[i], HALO_FORWARD_TAG, MPI_COMM_WORLD, &binding.requests[n++]);
+        }
+    }
+    binding.numberOfSend = n - binding.numberOfRecv;
+}
+
+// Collective. The window over the halo region of x, the puts are issued at start
+static void InitRmaBinding (const SparseMatrix &A, HaloBinding &binding, double *x) {
+    binding.buffer = x;
+    binding.numberOfRecv = binding.numberOfSend = 0;
+    binding.requests = NULL;
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, (char *) "no_locks", (char *) "true");
+    MPI_Win_create(x + A.localNumberOfRows, (MPI_Aint) A.totalNumberOfRecv * sizeof(double), sizeof(double),
+            info, MPI_COMM_WORLD, &binding.window);
+    MPI_Info_free(&info);
+}
+
+// Moves the binding of buffer to the front. Returns false if there is none: the front is then
+// a free slot (the least recently used binding is freed when all of them are in use).
+static bool FindBinding (HaloBinding *bindings, int &n, const double *buffer) {
+    int b = 0;
+    while (b < n && bindings[b].buffer != buffer) b++;
+    const bool found = b < n;
+    if (!found) {
+        if (n == HALO_MAXIMUM_BINDINGS) FreeBinding(bindings[--n]);
+        b = n++;
+    }
+    HaloBinding binding = bindings[b];
+    for (; b > 0; b--) bindings[b] = bindings[b-1];
+    bindings[0] = binding;
+    return found;
+}
+
+static void StartBinding (HaloExchange &halo, HaloBinding &binding) {
+    if (binding.numberOfRecv + binding.numberOfSend) {
+        MPI_Startall(binding.numberOfRecv + binding.numberOfSend, binding.requests);
+    }
+    halo.active = &binding;
+}
+
+void StartHaloExchange (const SparseMatrix &A, Vector &x) {
+    HaloExchange &halo = *A.halo;
+    if (halo.method == HALO_NEIGHBOR) {
+        if (halo.sendTypes) {
+            MPI_Ineighbor_alltoallw(x.values, halo.sendCounts, halo.sendBytes, halo.sendTypes,
+                    x.values + A.localNumberOfRows, A.recvLength, halo.recvBytes, halo.recvTypes,
+                    halo.graphComm, &halo.neighborRequest);
+        } else {
+            MPI_Ineighbor_alltoallv(A.sendBuffer, A.sendLength, halo.sendDispl, MPI_DOUBLE,
+                    x.values + A.localNumberOfRows, A.recvLength, halo.recvDispl, MPI_DOUBLE,
+                    halo.graphComm, &halo.neighborRequest);
+        }
+        halo.active = NULL;
+        return;
+    }
+    if (halo.method == HALO_RMA) {
+        if (!FindBinding(halo.forward, halo.numberOfForwardBindings, x.values)) {
+            InitRmaBinding(A, halo.forward[0], x.values);
+        }
+        const MPI_Win window = halo.forward[0].window;
+        MPI_Win_post(halo.exposureGroup, 0, window);
+        MPI_Win_start(halo.accessGroup, 0, window);
+        for (int i = 0, offset = 0; i < A.numberOfSendNeighbors; offset += A.sendLength[i++]) {
+            if (halo.sendTypes) {
+                MPI_Put(x.values, 1, halo.sendTypes[i], A.sendNeighbors[i], halo.targetDispl[i], A.sendLength[i], MPI_DOUBLE, window);
+                continue;
+            }
+            const int contiguous = halo.sendContiguous[i], rest = A.sendLength[i] - contiguous;
+            if (contiguous) {
+                MPI_Put(x.values + A.localIndexOfSend[offset], contiguous, MPI_DOUBLE, A.sendNeighbors[i], halo.targetDispl[i], contiguous, MPI_DOUBLE, window);
+            }
+            if (rest) {
+                MPI_Put(A.sendBuffer + offset + contiguous, rest, MPI_DOUBLE, A.sendNeighbors[i], halo.targetDispl[i] + contiguous, rest, MPI_DOUBLE, window);
+            }
+        }
+        halo.rmaActive = &halo.forward[0];
+        halo.active = NULL;
+        return;
+    }
+    if (!FindBinding(halo.forward, halo.numberOfForwardBindings, x.values)) {
+        InitForwardBinding(A, halo, halo.forward[0], x.values);
+    }
+    StartBinding(halo, halo.forward[0]);
+}
+
+void StartReverseHaloExchange (const SparseMatrix &A, const double *contribution) {
+    HaloExchange &halo = *A.halo;
+    if (!FindBinding(halo.reverse, halo.numberOfReverseBindings, contribution)) {
+        InitBinding(halo.reverse[0], contribution, HALO_REVERSE_TAG,
+                A.numberOfSendNeighbors, A.sendNeighbors, A.sendLength, A.sendBuffer,
+                A.numberOfRecvNeighbors, A.recvNeighbors, A.recvLength, contribution);
+    }
+    StartBinding(halo, halo.reverse[0]);
+}
+
+// Without an active binding the neighborhood collective is waited for, it completes both
+// directions (WaitHaloSend has nothing left to do)
+static void WaitNeighborExchange (HaloExchange &halo) {
+    if (MPI_Wait(&halo.neighborRequest, MPI_STATUS_IGNORE)) {
+        std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
+        std::exit(-1);
+    }
+}
+
+// Both epochs are closed once : the puts of this rank and the ones into its window are done
+static void WaitRmaExchange (HaloExchange &halo) {
+    if (!halo.rmaActive) return;
+    MPI_Win_complete(halo.rmaActive->window);
+    MPI_Win_wait(halo.rmaActive->window);
+    halo.rmaActive = NULL;
+}
+
+void WaitHaloRecv (const SparseMatrix &A) {
+    if (!A.halo->active) {
+        if (A.halo->method == HALO_RMA) WaitRmaExchange(*A.halo);
+        else WaitNeighborExchange(*A.halo);
+        return;
+    }
+    const HaloBinding &binding = *A.halo->active;
+    if (binding.numberOfRecv) {
+        if (MPI_Waitall(binding.numberOfRecv, binding.requests, MPI_STATUSES_IGNORE)) {
+            std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
+            std::exit(-1);
+        }
+    }
+}
+
+void WaitHaloSend (const SparseMatrix &A) {
+    if (!A.halo->active) {
+        if (A.halo->method == HALO_RMA) WaitRmaExchange(*A.halo);
+        else WaitNeighborExchange(*A.halo);
+        return;
+    }
+    const HaloBinding &binding = *A.halo->active;
+    if (binding.numberOfSend) {
+        if (MPI_Waitall(binding.numberOfSend, binding.requests + binding.numberOfRecv, MPI_STATUSES_IGNORE)) {
+            std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
+            std::exit(-1);
+        }
+    }
+    A.halo->active = NULL;
+}
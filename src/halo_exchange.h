@@ -0,0 +1,115 @@
+#pragma once
+#include <mpi.h>
+#include <string>
+#include "sparse_matrix.h"
+#include "vector.h"
+
+//------------------------------------------
+// Halo exchange with persistent requests
+//------------------------------------------
+// The requests (MPI_Recv_init / MPI_Send_init) are created the first time a buffer is
+// exchanged and restarted by the following calls, so a repeated SpMV neither allocates
+// nor posts requests. The forward exchange receives the external part of x from the
+// neighbors (the packed values are sent from A.sendBuffer), the reverse exchange sends
+// the contributions to the external rows back into A.sendBuffer of their owners.
+// A few buffers are kept bound (x and the vectors of an iteration), the least recently
+// used binding is freed beyond HALO_MAXIMUM_BINDINGS.
+//
+// HALO_NEIGHBOR runs the forward exchange as one MPI_Ineighbor_alltoallv on a distributed
+// graph communicator (sources = recvNeighbors, destinations = sendNeighbors), the reverse
+// exchange stays point-to-point.
+//
+// HALO_RMA puts the packed values into a window over the halo region of the exchanged vector,
+// at offsets received from the targets once. A forward binding holds the window of its vector,
+// so the window is created (collectively) the first time a vector is exchanged and freed with
+// the binding: every rank has to exchange the same vectors in the same order, as the SpMV
+// drivers do. An exchange is one access epoch (MPI_Win_start/complete, group = send neighbors)
+// and one exposure epoch (MPI_Win_post/wait, group = recv neighbors). The reverse exchange
+// stays point-to-point.
+//
+// PACK_DATATYPE sends the forward exchange straight from x.values : the send list of every
+// neighbor is an MPI_Type_create_indexed_block over x (blocks of one double at localIndexOfSend),
+// the MPI library gathers the values and A.sendBuffer is not filled (PACK_BUFFER : the caller
+// packs x into A.sendBuffer before the exchange). A.sendBuffer still receives the reverse exchange.
+//
+// With PACK_BUFFER a send list that begins with consecutive local rows (the whole list or at
+// least HALO_MINIMUM_CONTIGUOUS_SEND of them, see the 'send' row order of the partitioner) is
+// sent as the range straight from x (HALO_CONTIGUOUS_TAG) and the rest from A.sendBuffer, only
+// the rest is packed (PackHaloSend). The receivers get the lengths of the ranges at creation.
+// HALO_NEIGHBOR sends one packed message to every neighbor.
+#define HALO_P2P                0
+#define HALO_NEIGHBOR           1
+#define HALO_RMA                2
+#define NUMBER_OF_HALO_METHODS  3
+#define HALO_MAXIMUM_BINDINGS   4
+#define PACK_BUFFER             0
+#define PACK_DATATYPE           1
+#define HALO_MINIMUM_CONTIGUOUS_SEND    8
+#define HALO_FORWARD_TAG        141421356
+#define HALO_REVERSE_TAG        173205080
+#define HALO_SETUP_TAG          244948974
+#define HALO_CONTIGUOUS_TAG     264575131
+#define HALO_SPMM_TAG           282842712
+
+struct HaloBinding {
+    const double *buffer;           // x.values (forward), the contributions (reverse)
+    int numberOfRecv;
+    int numberOfSend;
+    MPI_Request *requests;          // [numberOfRecv + numberOfSend] receives, then sends
+    MPI_Win window;                 // HALO_RMA : over the halo region of buffer, MPI_WIN_NULL otherwise
+};
+
+struct HaloExchange {
+    int method;
+    int numberOfForwardBindings;
+    int numberOfReverseBindings;
+    HaloBinding forward[HALO_MAXIMUM_BINDINGS];     // the most recently used first
+    HaloBinding reverse[HALO_MAXIMUM_BINDINGS];
+    HaloBinding *active;            // started and not waited for
+    int packing;
+    MPI_Datatype *sendTypes;        // [numberOfSendNeighbors] PACK_DATATYPE, NULL otherwise
+    int *sendContiguous;            // [numberOfSendNeighbors] length of the range sent from x (0 : none)
+    int *recvContiguous;            // [numberOfRecvNeighbors] the same of the sender
+    int numberOfPackedSend;         // entries of A.sendBuffer gathered by PackHaloSend
+    int *packedSend;                // [numberOfPackedSend] their positions, NULL : all of them
+
+    // HALO_NEIGHBOR
+    MPI_Comm graphComm;
+    bool rankReordered;             // the graph communicator numbers this rank differently
+    int *sendDispl;                 // [numberOfSendNeighbors]
+    int *recvDispl;                 // [numberOfRecvNeighbors]
+    MPI_Request neighborRequest;    // MPI_REQUEST_NULL when not started
+    int *sendCounts;                // [numberOfSendNeighbors] PACK_DATATYPE : MPI_Ineighbor_alltoallw
+    MPI_Aint *sendBytes;            // [numberOfSendNeighbors] (ones and zeros, the types hold the offsets)
+    MPI_Aint *recvBytes;            // [numberOfRecvNeighbors] recvDispl in bytes
+    MPI_Datatype *recvTypes;        // [numberOfRecvNeighbors] MPI_DOUBLE
+
+    // HALO_RMA
+    HaloBinding *rmaActive;         // the started forward exchange, NULL when waited for
+    MPI_Group accessGroup;          // send neighbors
+    MPI_Group exposureGroup;        // recv neighbors
+    int *targetDispl;               // [numberOfSendNeighbors] offset in the window of the neighbor
+};
+
+int GetHaloMethod (const std::string &name);
+const char* GetHaloMethodName (int method);
+int GetPackMethod (const std::string &name);
+const char* GetPackMethodName (int packing);
+// Collective. reorderRanks lets MPI renumber the ranks of the graph
+// communicator (HALO_NEIGHBOR), the data is not moved: only the placement of the processes
+// in the communicator changes.
+void CreateHaloExchange (SparseMatrix &A, int method, int packing, bool reorderRanks = false);
+// Frees the persistent requests (before MPI_Finalize)
+void DeleteHaloExchange (SparseMatrix &A);
+// Collective. A.localIndexOfSend has changed : the datatypes, the contiguous ranges and the
+// requests bound to them are rebuilt
+void UpdateHaloSendIndices (SparseMatrix &A);
+// Gathers the entries of x that are sent from A.sendBuffer (nothing with PACK_DATATYPE)
+void PackHaloSend (const SparseMatrix &A, const double *x);
+// A.sendBuffer must hold the packed values of x (PACK_BUFFER)
+void StartHaloExchange (const SparseMatrix &A, Vector &x);
+// contribution[totalNumberOfRecv] is sent to the owners of the external rows, A.sendBuffer
+// receives (the forward exchange must have been completed)
+void StartReverseHaloExchange (const SparseMatrix &A, const double *contribution);
+void WaitHaloRecv (const SparseMatrix &A);
+void WaitHaloSend (const SparseMatrix &A);
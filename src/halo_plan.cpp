@@ -0,0 +1,131 @@
+#include <mpi.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "halo_plan.h"
+using namespace std;
+
+void BuildHaloPlan (SparseMatrix &A, int nLocal, const int *localRowGlobal, const int *ptr, const int *globalCol, const double *val, const OwnerLookup &lookupOwner) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    const int nNnz = ptr[nLocal];
+    A.localNumberOfRows = nLocal;
+    A.localNumberOfNonzeros = nNnz;
+
+    //--------------------------------------------------------------------------------
+    // Columns which are not local rows are external
+    //--------------------------------------------------------------------------------
+    GlobalToLocalTable localRows;
+    CreateGlobalToLocalTable(localRows, localRowGlobal, nLocal);
+    vector<int> localCol(nNnz);
+    TranslateGlobalToLocal(localRows, globalCol, localCol.data(), nNnz);
+    vector<int> externalCol;
+    for (int i = 0; i < nNnz; i++) {
+        if (localCol[i] < 0) externalCol.push_back(globalCol[i]);
+    }
+    sort(externalCol.begin(), externalCol.end());
+    externalCol.erase(unique(externalCol.begin(), externalCol.end()), externalCol.end());
+
+    //--------------------------------------------------------------------------------
+    // Recv : external columns ordered by (owner, global index)
+    //--------------------------------------------------------------------------------
+    vector<int> owners;
+    lookupOwner(externalCol, owners);
+    {
+        vector< pair<int, int> > keys(externalCol.size());
+        for (size_t i = 0; i < externalCol.size(); i++) {
+            if (owners[i] < 0 || owners[i] >= size || owners[i] == rank) {
+                cerr << "Invalid owner " << owners[i] << " of column " << externalCol[i] << " on rank " << rank << endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            keys[i] = make_pair(owners[i], externalCol[i]);
+        }
+        sort(keys.begin(), keys.end());
+        for (size_t i = 0; i < keys.size(); i++) {
+            owners[i] = keys[i].first;
+            externalCol[i] = keys[i].second;
+        }
+    }
+    vector<int> recvCount(size, 0), sendCount(size), recvDispl(size + 1, 0), sendDispl(size + 1, 0);
+    for (size_t i = 0; i < owners.size(); i++) recvCount[owners[i]]++;
+    A.totalNumberOfRecv = externalCol.size();
+    A.numberOfRecvNeighbors = size - count(recvCount.begin(), recvCount.end(), 0);
+    A.recvNeighbors = new int[A.numberOfRecvNeighbors];
+    A.recvLength = new int[A.numberOfRecvNeighbors];
+    A.localIndexOfRecv = new int[A.totalNumberOfRecv];
+    for (int r = 0, k = 0; r < size; r++) {
+        if (recvCount[r]) {
+            A.recvNeighbors[k] = r;
+            A.recvLength[k] = recvCount[r];
+            k++;
+        }
+    }
+    for (int i = 0; i < A.totalNumberOfRecv; i++) A.localIndexOfRecv[i] = nLocal + i;
+
+    A.totalNumberOfUsedCols = nLocal + externalCol.size();
+    A.local2global = new int[A.totalNumberOfUsedCols];
+    copy(localRowGlobal, localRowGlobal + nLocal, A.local2global);
+    copy(externalCol.begin(), externalCol.end(), A.local2global + nLocal);
+    CreateGlobalToLocalTable(A.global2local, A.local2global, A.totalNumberOfUsedCols);
+
+    //--------------------------------------------------------------------------------
+    // Send : the owners are told which of their rows are needed
+    //--------------------------------------------------------------------------------
+    MPI_Alltoall(recvCount.data(), 1, MPI_INT, sendCount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0; r < size; r++) {
+        recvDispl[r+1] = recvDispl[r] + recvCount[r];
+        sendDispl[r+1] = sendDispl[r] + sendCount[r];
+    }
+    A.totalNumberOfSend = sendDispl[size];
+    A.numberOfSendNeighbors = size - count(sendCount.begin(), sendCount.end(), 0);
+    A.sendNeighbors = new int[A.numberOfSendNeighbors];
+    A.sendLength = new int[A.numberOfSendNeighbors];
+    A.localIndexOfSend = new int[A.totalNumberOfSend];
+    A.sendBuffer = new double[A.totalNumberOfSend];
+    MPI_Alltoallv(externalCol.data(), recvCount.data(), recvDispl.data(), MPI_INT,
+            A.localIndexOfSend, sendCount.data(), sendDispl.data(), MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0, k = 0; r < size; r++) {
+        if (sendCount[r]) {
+            A.sendNeighbors[k] = r;
+            A.sendLength[k] = sendCount[r];
+            k++;
+        }
+    }
+    TranslateGlobalToLocal(localRows, A.localIndexOfSend, A.localIndexOfSend, A.totalNumberOfSend);
+    for (int i = 0; i < A.totalNumberOfSend; i++) {
+        if (A.localIndexOfSend[i] < 0) {
+            cerr << "Requested row is not owned by rank " << rank << endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    DeleteGlobalToLocalTable(localRows);
+
+    //--------------------------------------------------------------------------------
+    // SubMatrix
+    //--------------------------------------------------------------------------------
+    int numInternalNnz = nNnz - count(localCol.begin(), localCol.end(), -1);
+    int numExternalNnz = nNnz - numInternalNnz;
+    A.internalPtr = new int[nLocal + 1];
+    A.internalIdx = new int[numInternalNnz];
+    A.internalVal = new double[numInternalNnz];
+    A.externalPtr = new int[nLocal + 1];
+    A.externalIdx = new int[numExternalNnz];
+    A.externalVal = new double[numExternalNnz];
+    A.internalPtr[0] = A.externalPtr[0] = 0;
+    for (int i = 0, in = 0, en = 0; i < nLocal; i++) {
+        for (int j = ptr[i]; j < ptr[i+1]; j++) {
+            if (localCol[j] >= 0) {
+                A.internalIdx[in] = localCol[j];
+                A.internalVal[in++] = val[j];
+            } else {
+                A.externalIdx[en] = globalCol[j];
+                A.externalVal[en++] = val[j];
+            }
+        }
+        A.internalPtr[i+1] = in;
+        A.externalPtr[i+1] = en;
+    }
+    TranslateGlobalToLocal(A.global2local, A.externalIdx, A.externalIdx, numExternalNnz);
+}
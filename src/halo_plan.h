@@ -0,0 +1,15 @@
+#pragma once
+#include <vector>
+#include <functional>
+#include "sparse_matrix.h"
+using namespace std;
+
+// owners[i] = rank owning the global row rows[i]. Called collectively by every rank.
+typedef function<void (const vector<int> &rows, vector<int> &owners)> OwnerLookup;
+
+// Build the local matrix and the halo exchange plan (collective).
+//   nLocal rows whose global indices are localRowGlobal[0..nLocal) are owned by this rank,
+//   ptr/globalCol/val is the CSR of these rows with global column indices.
+// Fills local2global (local rows followed by the external columns grouped by the owner),
+// global2local, the internal/external CSR and the send/recv lists of A.
+void BuildHaloPlan (SparseMatrix &A, int nLocal, const int *localRowGlobal, const int *ptr, const int *globalCol, const double *val, const OwnerLookup &lookupOwner);
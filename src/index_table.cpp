@@ -0,0 +1,49 @@
+#include <algorithm>
+#include "index_table.h"
+using namespace std;
+
+void CreateGlobalToLocalTable (GlobalToLocalTable &table, const int *local2global, int n) {
+    int log2Capacity = 4;
+    while ((1 << log2Capacity) < 2 * n) log2Capacity++;
+    table.capacity = 1 << log2Capacity;
+    table.shift = 32 - log2Capacity;
+    table.keys = new int[table.capacity];
+    table.values = new int[table.capacity];
+    fill(table.keys, table.keys + table.capacity, -1);
+    int mask = table.capacity - 1;
+    for (int i = 0; i < n; i++) {
+        int slot = HashGlobalIndex(table, local2global[i]);
+        while (table.keys[slot] != -1 && table.keys[slot] != local2global[i]) slot = (slot + 1) & mask;
+        table.keys[slot] = local2global[i];
+        table.values[slot] = i;
+    }
+}
+
+void DeleteGlobalToLocalTable (GlobalToLocalTable &table) {
+    delete [] table.keys;
+    delete [] table.values;
+    table.keys = table.values = NULL;
+    table.capacity = 0;
+}
+
+// Most of the indices are found at the first probe, so the first probe is done in a
+// branch free (vectorizable) loop and only the misses are resolved by linear probing.
+// A miss is marked as -2 - global so that global and local may be the same array.
+void TranslateGlobalToLocal (const GlobalToLocalTable &table, const int *global, int *local, int n) {
+    const int *keys = table.keys;
+    const int *values = table.values;
+    const int shift = table.shift;
+#pragma omp parallel
+    {
+#pragma omp for simd schedule(static)
+        for (int i = 0; i < n; i++) {
+            int g = global[i];
+            int slot = (int) (((unsigned) g * 2654435761u) >> shift);
+            local[i] = keys[slot] == g ? values[slot] : -2 - g;
+        }
+#pragma omp for schedule(static)
+        for (int i = 0; i < n; i++) {
+            if (local[i] <= -2) local[i] = GlobalToLocal(table, -2 - local[i]);
+        }
+    }
+}
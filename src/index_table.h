@@ -0,0 +1,32 @@
+#pragma once
+
+//------------------------------------------
+// Global -> local index table
+//------------------------------------------
+// Open addressing hash table (linear probing, load factor <= 0.5) built once from local2global.
+// keys[] holds global indices (-1 for an empty slot), values[] the corresponding local indices.
+struct GlobalToLocalTable {
+    int capacity;
+    int shift;
+    int *keys;
+    int *values;
+};
+
+void CreateGlobalToLocalTable (GlobalToLocalTable &table, const int *local2global, int n);
+void DeleteGlobalToLocalTable (GlobalToLocalTable &table);
+// local[i] = local index of global[i] (-1 if global[i] is not in the table)
+void TranslateGlobalToLocal (const GlobalToLocalTable &table, const int *global, int *local, int n);
+
+inline int HashGlobalIndex (const GlobalToLocalTable &table, int global) {
+    return (int) (((unsigned) global * 2654435761u) >> table.shift);
+}
+
+// Returns -1 if global is not in the table
+inline int GlobalToLocal (const GlobalToLocalTable &table, int global) {
+    int mask = table.capacity - 1;
+    for (int slot = HashGlobalIndex(table, global); ; slot = (slot + 1) & mask) {
+        int key = table.keys[slot];
+        if (key == global) return table.values[slot];
+        if (key == -1) return -1;
+    }
+}
@@ -0,0 +1,265 @@
+#include <mpi.h>
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include "ingest.h"
+#include "halo_plan.h"
+#include "mpi_util.h"
+#include "util.h"
+using namespace std;
+
+#define INGEST_MAX_LINE_LENGTH      1024
+#define INGEST_HEADER_READ_LENGTH   (1 << 16)
+#define INGEST_READ_BLOCK_LENGTH    (1 << 30)
+
+static void ReadAt (MPI_File fh, MPI_Offset offset, char *buf, MPI_Offset length) {
+    while (length > 0) {
+        int count = (int) min<MPI_Offset>(length, INGEST_READ_BLOCK_LENGTH);
+        MPI_Status status;
+        MPI_File_read_at(fh, offset, buf, count, MPI_CHAR, &status);
+        offset += count;
+        buf += count;
+        length -= count;
+    }
+}
+
+// Skip the banner and the comments, returns the offset of the first nonzero line
+static MPI_Offset ReadMatrixMarketHeader (MPI_File fh, MPI_Offset fileSize, int &nRow, int &nCol, int &nNnz, bool &symmetric) {
+    MPI_Offset offset = 0;
+    vector<char> buf;
+    while (offset < fileSize) {
+        buf.resize(min<MPI_Offset>(fileSize - offset, INGEST_HEADER_READ_LENGTH));
+        ReadAt(fh, offset, buf.data(), buf.size());
+        const char *eol = (const char *) memchr(buf.data(), '\n', buf.size());
+        if (eol == NULL && offset + (MPI_Offset) buf.size() < fileSize) {
+            cerr << "Too long header line" << endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        int length = eol ? eol - buf.data() : buf.size();
+        if (offset == 0) symmetric = IsSymmetricBanner(buf.data(), buf.data() + length);
+        const string line(buf.data(), length);
+        // the size line is the first one that is neither a comment nor blank
+        if (buf[0] != '%' && line.find_first_not_of(" \t\r") != string::npos) {
+            stringstream ss(line);
+            if (!(ss >> nRow >> nCol >> nNnz) || nRow <= 0 || nCol <= 0 || nNnz <= 0) {
+                cerr << "Invalid size line : " << line << endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            return offset + length + 1;
+        }
+        offset += length + 1;
+    }
+    cerr << "Size line not found" << endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+    return 0;
+}
+
+// Nonzeros whose line begins in [begin, end) of the file
+static void ReadMatrixMarketElements (MPI_File fh, MPI_Offset fileSize, MPI_Offset body, MPI_Offset begin, MPI_Offset end, vector<Element> &elements) {
+    if (begin == end) return;
+    MPI_Offset readBegin = max(body, begin - 1);
+    MPI_Offset readEnd = min(fileSize, end + INGEST_MAX_LINE_LENGTH);
+    vector<char> buf(readEnd - readBegin);
+    ReadAt(fh, readBegin, buf.data(), buf.size());
+    const char *bufEnd = buf.data() + buf.size();
+    const char *first = buf.data();
+    if (begin > body) {
+        first = (const char *) memchr(buf.data(), '\n', buf.size());
+        first = first ? first + 1 : bufEnd;
+    }
+    const char *last = bufEnd;
+    if (end < fileSize) {
+        const char *p = buf.data() + (end - 1 - readBegin);
+        last = (const char *) memchr(p, '\n', bufEnd - p);
+        if (last == NULL) {
+            cerr << "Line longer than " << INGEST_MAX_LINE_LENGTH << " bytes" << endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        last++;
+    }
+    if (first < last) ParseMatrixMarketElements(first, last, elements);
+}
+
+// rowBegin[k] = smallest row r such that (number of nonzeros in rows < r) >= nnz * k / size
+static void GetNonzeroBalancedRowBegin (const vector<Element> &elements, int nRow, long long nNnz, vector<int> &rowBegin, MPI_Datatype countType) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    // (row, count) of the local elements are sent to the block owner of the row
+    vector<int> blockBegin(size + 1);
+    for (int r = 0; r <= size; r++) blockBegin[r] = (long long) nRow * r / size;
+    vector< pair<int, int> > rowCount;
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (rowCount.empty() || rowCount.back().first != elements[i].row) rowCount.push_back(make_pair(elements[i].row, 0));
+        rowCount.back().second++;
+    }
+    vector<int> sendCount(size, 0), recvCount(size), sendDispl(size + 1, 0), recvDispl(size + 1, 0);
+    for (int i = 0, r = 0; i < (int) rowCount.size(); i++) {
+        while (rowCount[i].first >= blockBegin[r+1]) r++;
+        sendCount[r]++;
+    }
+    MPI_Alltoall(sendCount.data(), 1, MPI_INT, recvCount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0; r < size; r++) {
+        sendDispl[r+1] = sendDispl[r] + sendCount[r];
+        recvDispl[r+1] = recvDispl[r] + recvCount[r];
+    }
+    vector< pair<int, int> > blockRowCount(recvDispl[size]);
+    MPI_Alltoallv(rowCount.data(), sendCount.data(), sendDispl.data(), countType,
+            blockRowCount.data(), recvCount.data(), recvDispl.data(), countType, MPI_COMM_WORLD);
+
+    vector<long long> count(blockBegin[rank+1] - blockBegin[rank], 0);
+    for (size_t i = 0; i < blockRowCount.size(); i++) count[blockRowCount[i].first - blockBegin[rank]] += blockRowCount[i].second;
+    long long blockNnz = 0, prefix = 0;
+    for (size_t i = 0; i < count.size(); i++) blockNnz += count[i];
+    MPI_Exscan(&blockNnz, &prefix, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0) prefix = 0;
+
+    const long long blockPrefix = prefix;
+    vector<int> candidate(size + 1, nRow);
+    candidate[0] = 0;
+    for (int k = 1, i = 0; k < size; k++) {
+        long long target = nNnz * k / size;
+        if (target <= 0) { candidate[k] = 0; continue; }
+        if (target <= blockPrefix) continue;
+        while (i < (int) count.size() && prefix + count[i] < target) prefix += count[i++];
+        if (i < (int) count.size()) candidate[k] = blockBegin[rank] + i + 1;
+    }
+    rowBegin.resize(size + 1);
+    MPI_Allreduce(candidate.data(), rowBegin.data(), size + 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    for (int k = 1; k <= size; k++) amax(rowBegin[k], rowBegin[k-1]);
+}
+
+void LoadMatrixMarketInput (const string &mtxFile, SparseMatrix &A, Vector &x, int rowDistribution) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    MPI_File fh;
+    if (MPI_File_open(MPI_COMM_WORLD, (char *) mtxFile.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) != MPI_SUCCESS) {
+        if (rank == 0) cerr << "File not found : " + mtxFile << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Offset fileSize;
+    MPI_File_get_size(fh, &fileSize);
+
+    //--------------------------------------------------------------------------------
+    // Header
+    //--------------------------------------------------------------------------------
+    int nRow, nCol, nNnz;
+    bool symmetric = false;
+    MPI_Offset body;
+    {
+        long long header[5];
+        if (rank == 0) {
+            body = ReadMatrixMarketHeader(fh, fileSize, nRow, nCol, nNnz, symmetric);
+            header[0] = nRow; header[1] = nCol; header[2] = nNnz; header[3] = body; header[4] = symmetric;
+        }
+        MPI_Bcast(header, 5, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+        nRow = header[0]; nCol = header[1]; nNnz = header[2]; body = header[3]; symmetric = header[4];
+    }
+    assert(nRow == nCol);
+    A.globalNumberOfRows = nRow;
+    A.globalNumberOfNonzeros = nNnz;
+    A.symmetric = symmetric;
+
+    //--------------------------------------------------------------------------------
+    // Each rank parses the lines beginning in its byte range
+    //--------------------------------------------------------------------------------
+    vector<Element> elements;
+    {
+        MPI_Offset bodySize = max<MPI_Offset>(fileSize - body, 0);
+        MPI_Offset begin = body + bodySize * rank / size;
+        MPI_Offset end = body + bodySize * (rank + 1) / size;
+        elements.reserve((long long) nNnz / size + 16);
+        ReadMatrixMarketElements(fh, fileSize, body, begin, end, elements);
+    }
+    MPI_File_close(&fh);
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (elements[i].row < 0 || elements[i].row >= nRow || elements[i].col < 0 || elements[i].col >= nCol) {
+            cerr << mtxFile << ": index out of range (" << elements[i].row + 1 << ", " << elements[i].col + 1 << ")" << endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    {
+        long long nLocal = elements.size(), nTotal;
+        MPI_Allreduce(&nLocal, &nTotal, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        if (nTotal != nNnz) {
+            if (rank == 0) cerr << mtxFile << ": expected " << nNnz << " nonzeros, found " << nTotal << endl;
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+    }
+    if (symmetric) {
+        // the file is stored as it is (lower triangle), the diagonal is counted once
+        long long nDiagonal = 0, nTotalDiagonal;
+        for (size_t i = 0; i < elements.size(); i++) {
+            if (elements[i].row < elements[i].col) swap(elements[i].row, elements[i].col);
+            nDiagonal += elements[i].row == elements[i].col;
+        }
+        MPI_Allreduce(&nDiagonal, &nTotalDiagonal, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+        A.globalNumberOfNonzeros = 2 * (long long) nNnz - nTotalDiagonal;
+    }
+    sort(elements.begin(), elements.end(), RowComparator());
+
+    //--------------------------------------------------------------------------------
+    // Row distribution
+    //--------------------------------------------------------------------------------
+    MPI_Datatype elementType, countType;
+    MPI_Type_contiguous(sizeof(Element), MPI_BYTE, &elementType);
+    MPI_Type_commit(&elementType);
+    MPI_Type_contiguous(sizeof(pair<int, int>), MPI_BYTE, &countType);
+    MPI_Type_commit(&countType);
+    vector<int> rowBegin(size + 1);
+    if (rowDistribution == ROW_DISTRIBUTION_NONZERO) {
+        GetNonzeroBalancedRowBegin(elements, nRow, nNnz, rowBegin, countType);
+    } else {
+        for (int r = 0; r <= size; r++) rowBegin[r] = (long long) nRow * r / size;
+    }
+
+    //--------------------------------------------------------------------------------
+    // Route the nonzeros to the owners of their rows
+    //--------------------------------------------------------------------------------
+    {
+        vector<int> sendCount(size, 0), recvCount(size), sendDispl(size + 1, 0), recvDispl(size + 1, 0);
+        for (int i = 0, r = 0; i < (int) elements.size(); i++) {
+            while (elements[i].row >= rowBegin[r+1]) r++;
+            sendCount[r]++;
+        }
+        MPI_Alltoall(sendCount.data(), 1, MPI_INT, recvCount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+        for (int r = 0; r < size; r++) {
+            sendDispl[r+1] = sendDispl[r] + sendCount[r];
+            recvDispl[r+1] = recvDispl[r] + recvCount[r];
+        }
+        vector<Element> received(recvDispl[size]);
+        MPI_Alltoallv(elements.data(), sendCount.data(), sendDispl.data(), elementType,
+                received.data(), recvCount.data(), recvDispl.data(), elementType, MPI_COMM_WORLD);
+        elements.swap(received);
+    }
+    MPI_Type_free(&elementType);
+    MPI_Type_free(&countType);
+    sort(elements.begin(), elements.end(), RowComparator());
+
+    //--------------------------------------------------------------------------------
+    // Local matrix and halo plan
+    //--------------------------------------------------------------------------------
+    {
+        const int rb = rowBegin[rank], nLocal = rowBegin[rank+1] - rowBegin[rank];
+        vector<int> localRowGlobal(nLocal), ptr(nLocal + 1), col(elements.size());
+        vector<double> val(elements.size());
+        for (int i = 0; i < nLocal; i++) localRowGlobal[i] = rb + i;
+        int p = 0;
+        for (size_t i = 0; i < elements.size(); i++) {
+            while (p <= elements[i].row - rb) ptr[p++] = i;
+            col[i] = elements[i].col;
+            val[i] = elements[i].val;
+        }
+        while (p <= nLocal) ptr[p++] = elements.size();
+        CreateOwnershipDirectory(A.rowOwner, nRow, localRowGlobal.data(), nLocal);
+        const OwnershipDirectory &rowOwner = A.rowOwner;
+        BuildHaloPlan(A, nLocal, localRowGlobal.data(), ptr.data(), col.data(), val.data(), 
+                [&rowOwner](const vector<int> &rows, vector<int> &owners) { LookupOwners(rowOwner, rows, owners); });
+    }
+    CompleteLoadInput(A, x);
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <string>
+#include "sparse_matrix.h"
+#include "vector.h"
+using namespace std;
+
+#define ROW_DISTRIBUTION_BLOCK      0   // equal number of rows
+#define ROW_DISTRIBUTION_NONZERO    1   // equal number of nonzeros
+
+// Read a Matrix Market file with MPI-IO and distribute contiguous row ranges to the ranks
+void LoadMatrixMarketInput (const string &mtxFile, SparseMatrix &A, Vector &x, int rowDistribution);
@@ -1,6 +1,7 @@
 #include <mpi.h>
 #include <ctime>
 #include <cstdlib>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 #include <omp.h>
@@ -10,6 +11,11 @@
 #include "spmv.h"
 #include "util.h"
 #include "mpi_util.h"
+#include "ingest.h"
+#include "spmv_kernel.h"
+#include "matrix_powers.h"
+#include "reorder.h"
+#include "halo_exchange.h"
 #include "timing.h"
 #ifdef PRINT_NUMABIND
 #include "numa.h"
@@ -23,9 +29,76 @@ vector<double>  timingTemp(NUMBER_OF_TIMING);
 #define PERR(s)   if (rank == 0) fprintf(stderr, "%s", s);
 #define POUT(s)   if (rank == 0) fprintf(stdout, "%s", s);
 
+// Best time of NUMBER_OF_LOOP_OF_SPMV runs, each repeats SpMV for at least THRESHOLD_SECOND
+static double MeasureSpMV (const SparseMatrix &A, Vector &x, Vector &y, int &nLoop) {
+    double best = 0;
+    for (int i = 0; i < NUMBER_OF_LOOP_OF_SPMV; i++) {
+        nLoop = 1;
+        {
+            double begin = GetSynchronizedTime();
+            while (GetSynchronizedTime() - begin < THRESHOLD_SECOND)  {
+                for (int l = 0; l < nLoop; l++) {
+#ifdef SPMV_OVERLAP
+                    SpMV_overlap(A, x, y);
+#else
+                    SpMV_no_overlap(A, x, y);
+#endif
+                }
+                nLoop *= 2;
+            }
+        }
+        double elapsedTime = -GetBarrieredTime();
+        for (int l = 0; l < nLoop; l++) {
+#ifdef SPMV_OVERLAP
+            SpMV_overlap(A, x, y);
+#else
+            SpMV_no_overlap(A, x, y);
+#endif
+        }
+        elapsedTime += GetBarrieredTime();
+        if (!i || best > elapsedTime / nLoop) {
+            best = elapsedTime / nLoop;
+        }
+    }
+    return best;
+}
+
+// MeasureSpMV on the plain CSR blocks of A (no other storage format, no MKL handle)
+static double MeasureCsrSpMV (const SparseMatrix &A, Vector &x, Vector &y) {
+    SparseMatrix csr = A;
+    csr.internalFormat = csr.externalFormat = FORMAT_CSR;
+    csr.internalSchedule = csr.externalSchedule = SCHEDULE_STATIC;
+#ifdef MKL_INSPECTOR_EXECUTOR
+    csr.internalHandle = csr.externalHandle = NULL;
+#endif
+    int nLoop;
+    return MeasureSpMV(csr, x, y, nLoop);
+}
+
+// Same as MeasureSpMV for another distributed kernel (SpMM, transpose SpMV)
+template<class Kernel>
+static double MeasureKernel (Kernel kernel) {
+    double best = 0;
+    for (int i = 0; i < NUMBER_OF_LOOP_OF_SPMV; i++) {
+        int nLoop = 1;
+        double begin = GetSynchronizedTime();
+        while (GetSynchronizedTime() - begin < THRESHOLD_SECOND)  {
+            for (int l = 0; l < nLoop; l++) kernel();
+            nLoop *= 2;
+        }
+        double elapsedTime = -GetBarrieredTime();
+        for (int l = 0; l < nLoop; l++) kernel();
+        elapsedTime += GetBarrieredTime();
+        if (!i || best > elapsedTime / nLoop) {
+            best = elapsedTime / nLoop;
+        }
+    }
+    return best;
+}
+
 int main (int argc, char *argv[]) {
     if (argc < 2) {
-        printf("Usage: %s <prefix of part file (i.e. 'partition/test.mtx')> [matrix file (to verify)]\n", argv[0]);
+        printf("Usage: %s <prefix of part file (i.e. 'partition/test.mtx') or matrix file (*.mtx)> [matrix file (to verify)]\n", argv[0]);
         exit(1);
     }
     string mtxFile;
@@ -36,6 +109,7 @@ int main (int argc, char *argv[]) {
     }
     string partName = argv[1];
     string mtxName = GetBasename(argv[1]);
+    string rowDistribution = GetEnvOption("SPMV_ROW_DISTRIBUTION", "nonzero");
     MPI_Init(&argc, &argv);
 
     //------------------------------
@@ -46,6 +120,11 @@ int main (int argc, char *argv[]) {
     MPI_Comm_size(MPI_COMM_WORLD, &size);
     if (rank == 0) fprintf(stderr, "Begin %s\n", mtxName.c_str());
     string partFile = string(argv[1]) + "-" + to_string(static_cast<long long>(size)) + "-" + to_string(static_cast<long long>(rank)) + ".part"; 
+    string binaryPartFile = partFile.substr(0, partFile.size() - 5) + ".bpart";
+    // A matrix file is read and distributed directly when there is no part file
+    int ingest = 0;
+    if (rank == 0) ingest = !ExistsFile(partFile) && !ExistsFile(binaryPartFile) && ExistsFile(partName);
+    MPI_Bcast(&ingest, 1, MPI_INT, 0, MPI_COMM_WORLD);
     PERR("Loading sparse matrix and vector ... ");
 #ifdef GPU
     SelectDevice();
@@ -53,11 +132,32 @@ int main (int argc, char *argv[]) {
     MPI_Barrier(MPI_COMM_WORLD); fflush(stderr); fflush(stdout);
     SparseMatrix A;
     Vector x, y;
-    LoadInput(partFile, A, x);
+    if (ingest) {
+        LoadMatrixMarketInput(partName, A, x, rowDistribution == "block" ? ROW_DISTRIBUTION_BLOCK : ROW_DISTRIBUTION_NONZERO);
+    } else if (ExistsFile(binaryPartFile)) {
+        LoadBinaryInput(binaryPartFile, A, x);
+    } else {
+        LoadInput(partFile, A, x);
+    }
+    CreateLocalVector(A, y);
+    // the local rows are reordered (SPMV_REORDER) before the storage formats are built,
+    // the CSR SpMV is measured before and after : bandwidth and profile (before, after)
+    int reorder = GetReorderMethod(GetEnvOption("SPMV_REORDER", "none"));
+    long long localBandwidth[4];
+    double unorderedTime = 0;
+    if (reorder != REORDER_NONE) {
+#ifndef USE_DENSE_INTERNAL_INDEX
+        unorderedTime = MeasureCsrSpMV(A, x, y);
+#endif
+        ReorderLocalRows(A, x, reorder, localBandwidth, localBandwidth + 2);
+    }
 #ifdef USE_DENSE_INTERNAL_INDEX
     CreateDenseInternalIdx(A, x);
 #endif
-    CreateZeroVector(y, A.localNumberOfRows);
+    double autotuneTime = MPI_Wtime();
+    bool autotuned = CreateStorageFormat(A, x, y);
+    autotuneTime = MPI_Wtime() - autotuneTime;
+    double mklInspectionTime = CreateMklHandles(A);
     MPI_Barrier(MPI_COMM_WORLD); fflush(stderr); fflush(stdout);
     PERR("done\n");
 
@@ -71,34 +171,45 @@ int main (int argc, char *argv[]) {
     PERR("Computing SpMV ... ");
     timingDetail[TIMING_TOTAL_SPMV] = "TotalSpMV";
     int nLoop;
-    for (int i = 0; i < NUMBER_OF_LOOP_OF_SPMV; i++) {
-        nLoop = 1;
-        {
-            double begin = GetSynchronizedTime();
-            while (GetSynchronizedTime() - begin < THRESHOLD_SECOND)  {
-                for (int l = 0; l < nLoop; l++) {
-#ifdef SPMV_OVERLAP
-                    SpMV_overlap(A, x, y);
-#else
-                    SpMV_no_overlap(A, x, y);
-#endif
-                }
-                nLoop *= 2;
-            }
-        }
-        double elapsedTime = -GetBarrieredTime();
-        for (int l = 0; l < nLoop; l++) {
-#ifdef SPMV_OVERLAP
-            SpMV_overlap(A, x, y);
-#else
-            SpMV_no_overlap(A, x, y);
-#endif
-        }
-        elapsedTime += GetBarrieredTime();
-        if (!i || timing[TIMING_TOTAL_SPMV] > elapsedTime / nLoop) {
-            timing[TIMING_TOTAL_SPMV] = elapsedTime / nLoop;
-        }
+    timing[TIMING_TOTAL_SPMV] = MeasureSpMV(A, x, y, nLoop);
+    // the CSR numbers are measured too when another format is selected on any rank
+    double csrTime = timing[TIMING_TOTAL_SPMV];
+    int localNonCsr = A.internalFormat != FORMAT_CSR || A.externalFormat != FORMAT_CSR, nonCsr;
+    MPI_Allreduce(&localNonCsr, &nonCsr, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    if (nonCsr) csrTime = MeasureCsrSpMV(A, x, y);
+    double reorderedTime = 0;
+    if (unorderedTime > 0) reorderedTime = MeasureCsrSpMV(A, x, y);
+    // the point-to-point exchange is measured too when another one is selected
+    double p2pTime = 0;
+    if (A.halo->method != HALO_P2P) {
+        SparseMatrix p2p = A;
+        CreateHaloExchange(p2p, HALO_P2P, A.halo->packing);
+        int p2pLoop;
+        p2pTime = MeasureSpMV(p2p, x, y, p2pLoop);
+        DeleteHaloExchange(p2p);
+    }
+    // and the explicit packing into sendBuffer when the sends use datatypes over x
+    // (kept for the breakdown of SpMV_measurement_once)
+    double bufferTime = 0;
+    SparseMatrix buffered = A;
+    if (A.halo->packing != PACK_BUFFER) {
+        CreateHaloExchange(buffered, A.halo->method, PACK_BUFFER);
+        int bufferLoop;
+        bufferTime = MeasureSpMV(buffered, x, y, bufferLoop);
     }
+    // the legacy mkl_dcsrmv numbers are measured too when inspector-executor handles are used
+    double legacyTime = 0;
+    int mklHandles = 0;
+#ifdef MKL_INSPECTOR_EXECUTOR
+    int localMklHandles = A.internalHandle || A.externalHandle;
+    MPI_Allreduce(&localMklHandles, &mklHandles, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+    if (mklHandles) {
+        SparseMatrix legacy = A;
+        legacy.internalHandle = legacy.externalHandle = NULL;
+        int legacyLoop;
+        legacyTime = MeasureSpMV(legacy, x, y, legacyLoop);
+    }
+#endif
     PERR("done\n");
 
     //------------------------------
@@ -136,14 +247,16 @@ int main (int argc, char *argv[]) {
     timingDetail[TIMING_INTERNAL_COMPUTATION]  = "InternalComputation";
     timingDetail[TIMING_EXTERNAL_COMPUTATION]  = "ExternalComputation";
     timingDetail[TIMING_PACKING] = "Packing";
+    if (A.halo->packing != PACK_BUFFER) timingDetail[TIMING_BUFFER_COMMUNICATION] = (char *) "BufferCommunication";
     for (int i = 0; i < NUMBER_OF_LOOP_OF_MEASURENT_SPMV; i++) {
         fill(timingTemp.begin(), timingTemp.end(), 0);
-        SpMV_measurement_once(A, x, y);
+        SpMV_measurement_once(A, buffered, x, y);
         if (!i) {
             timing[TIMING_TOTAL_COMMUNICATION] = timingTemp[TIMING_TOTAL_COMMUNICATION];
             timing[TIMING_INTERNAL_COMPUTATION] = timingTemp[TIMING_INTERNAL_COMPUTATION];
             timing[TIMING_EXTERNAL_COMPUTATION] = timingTemp[TIMING_EXTERNAL_COMPUTATION];
             timing[TIMING_PACKING] = timingTemp[TIMING_PACKING];
+            timing[TIMING_BUFFER_COMMUNICATION] = timingTemp[TIMING_BUFFER_COMMUNICATION];
             timing[TIMING_TOTAL_COMPUTATION] = timingTemp[TIMING_INTERNAL_COMPUTATION] + 
                 timingTemp[TIMING_EXTERNAL_COMPUTATION];
         } else {
@@ -151,12 +264,120 @@ int main (int argc, char *argv[]) {
             amin(timing[TIMING_INTERNAL_COMPUTATION], timingTemp[TIMING_INTERNAL_COMPUTATION]);
             amin(timing[TIMING_EXTERNAL_COMPUTATION], timingTemp[TIMING_EXTERNAL_COMPUTATION]);
             amin(timing[TIMING_PACKING], timingTemp[TIMING_PACKING]);
+            amin(timing[TIMING_BUFFER_COMMUNICATION], timingTemp[TIMING_BUFFER_COMMUNICATION]);
             amin(timing[TIMING_TOTAL_COMPUTATION], timingTemp[TIMING_INTERNAL_COMPUTATION] + 
                     timingTemp[TIMING_EXTERNAL_COMPUTATION]);
         }
     }
+    if (buffered.halo != A.halo) DeleteHaloExchange(buffered);
     PERR("done\n");
 
+    //------------------------------
+    // SpMM (SPMV_SPMM_VECTORS = comma separated numbers of vectors)
+    //------------------------------
+    vector<int> spmmVectors;
+    vector<double> spmmTime;
+    {
+        istringstream iss(GetEnvOption("SPMV_SPMM_VECTORS", ""));
+        for (string k; getline(iss, k, ',');) {
+            if (atoi(k.c_str()) > 0) spmmVectors.push_back(atoi(k.c_str()));
+        }
+    }
+    if (A.symmetric && !spmmVectors.empty()) {
+        if (rank == 0) cerr << "SpMM is not supported for symmetric storage" << endl;
+        spmmVectors.clear();
+    }
+    if (!spmmVectors.empty()) {
+        PERR("Computing SpMM ... ");
+        // the vector v is (v + 1) x, so the result is checked against (v + 1) y
+        if (verify) {
+            fill(y.values, y.values + y.localLength, 0);
+            SpMV_no_overlap(A, x, y);
+        }
+        for (size_t n = 0; n < spmmVectors.size(); n++) {
+            const int k = spmmVectors[n];
+            MultiVector X, Y;
+            CreateMultiVector(A, X, k);
+            CreateMultiVector(A, Y, k);
+            for (int i = 0; i < A.localNumberOfRows; i++) {
+                for (int v = 0; v < k; v++) X.values[(long long) i * k + v] = (v + 1) * x.values[i];
+            }
+            spmmTime.push_back(MeasureKernel([&] { SpMM(A, X, Y); }));
+            if (verify) {
+                int localWrong = 0, wrong;
+                for (int i = 0; i < A.localNumberOfRows; i++) {
+                    for (int v = 0; v < k; v++) {
+                        double expected = (v + 1) * y.values[i];
+                        if (abs(Y.values[(long long) i * k + v] - expected) > 1e-8 * max(1.0, abs(expected))) localWrong = 1;
+                    }
+                }
+                MPI_Reduce(&localWrong, &wrong, 1, MPI_INT, MPI_LOR, 0, MPI_COMM_WORLD);
+                if (rank == 0 && wrong) cerr << "SpMM result is wrong for " << k << " vectors" << endl;
+            }
+            DeleteMultiVector(X);
+            DeleteMultiVector(Y);
+        }
+        PERR("done\n");
+    }
+
+    //------------------------------
+    // Transpose SpMV (SPMV_TRANSPOSE=1)
+    //------------------------------
+    bool transpose = GetEnvOption("SPMV_TRANSPOSE", "0") != "0";
+    double transposeTime = 0;
+    if (transpose) {
+        PERR("Computing transpose SpMV ... ");
+        if (!A.symmetric) CreateScatterSchedule(A);
+        transposeTime = MeasureKernel([&] { SpMVTranspose(A, x, y); });
+        if (verify) {
+            SpMVTranspose(A, x, y);
+            VerifySpMV(mtxFile, A, y, true);
+        }
+        PERR("done\n");
+    }
+
+    //------------------------------
+    // Matrix powers (SPMV_MPK_STEPS=k) against k calls of SpMV_overlap
+    //------------------------------
+    int mpkSteps = atoi(GetEnvOption("SPMV_MPK_STEPS", "0").c_str());
+    double mpkTime = 0, mpkSpMVTime = 0;
+    long long mpkGhostRows = 0, mpkRedundantNonzeros = 0;
+    if (A.symmetric && mpkSteps > 0) {
+        if (rank == 0) cerr << "The matrix powers kernel is not supported for symmetric storage" << endl;
+        mpkSteps = 0;
+    }
+    if (mpkSteps > 0) {
+        PERR("Computing matrix powers ... ");
+        MatrixPowersPlan P;
+        CreateMatrixPowersPlan(P, A, mpkSteps);
+        mpkTime = MeasureKernel([&] { MatrixPowers(P, x.values); });
+        Vector v[2];
+        CreateZeroVector(v[0], A.totalNumberOfUsedCols);
+        CreateZeroVector(v[1], A.totalNumberOfUsedCols);
+        mpkSpMVTime = MeasureKernel([&] {
+            copy(x.values, x.values + A.localNumberOfRows, v[0].values);
+            for (int s = 1; s <= mpkSteps; s++) SpMV_overlap(A, v[(s-1)%2], v[s%2]);
+        });
+        if (verify) {
+            int localWrong = 0, wrong;
+            const double *power = GetMatrixPower(P, mpkSteps);
+            const double *expected = v[mpkSteps%2].values;
+            for (int i = 0; i < A.localNumberOfRows; i++) {
+                if (abs(power[i] - expected[i]) > 1e-8 * max(1.0, abs(expected[i]))) localWrong = 1;
+            }
+            MPI_Reduce(&localWrong, &wrong, 1, MPI_INT, MPI_LOR, 0, MPI_COMM_WORLD);
+            if (rank == 0 && wrong) cerr << "Matrix powers result is wrong" << endl;
+        }
+        long long local[2] = {P.levelEnd[mpkSteps-1] - P.levelEnd[0], P.numberOfRedundantNonzeros}, global[2];
+        MPI_Reduce(local, global, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+        mpkGhostRows = global[0];
+        mpkRedundantNonzeros = global[1];
+        delete [] v[0].values;
+        delete [] v[1].values;
+        DeleteMatrixPowersPlan(P);
+        PERR("done\n");
+    }
+
     /*
     //------------------------------
     // DELETE
@@ -176,6 +397,59 @@ int main (int argc, char *argv[]) {
     // REPORT
     //------------------------------
     PERR("Reporting ... ");
+    long long localStoredNonzeros = A.localNumberOfNonzeros, storedNonzeros;
+    MPI_Reduce(&localStoredNonzeros, &storedNonzeros, 1, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    // padding of the SELL blocks : (stored elements, nonzeros)
+    long long localSell[2] = {0, 0}, sell[2];
+    if (A.internalFormat == FORMAT_SELL) {
+        localSell[0] += A.internalSell.numberOfStoredElements;
+        localSell[1] += A.internalSell.numberOfNonzeros;
+    }
+    if (A.externalFormat == FORMAT_SELL) {
+        localSell[0] += A.externalSell.numberOfStoredElements;
+        localSell[1] += A.externalSell.numberOfNonzeros;
+    }
+    MPI_Reduce(localSell, sell, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    // fill of the BCSR blocks : (stored elements, nonzeros)
+    long long localBcsr[2] = {0, 0}, bcsr[2];
+    if (A.internalFormat == FORMAT_BCSR) {
+        localBcsr[0] += A.internalBcsr.numberOfStoredElements;
+        localBcsr[1] += A.internalBcsr.numberOfNonzeros;
+    }
+    if (A.externalFormat == FORMAT_BCSR) {
+        localBcsr[0] += A.externalBcsr.numberOfStoredElements;
+        localBcsr[1] += A.externalBcsr.numberOfNonzeros;
+    }
+    MPI_Reduce(localBcsr, bcsr, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    // rows kept by the DCSR blocks : (non-empty rows, rows)
+    long long localDcsr[2] = {0, 0}, dcsr[2];
+    if (A.internalFormat == FORMAT_DCSR) {
+        localDcsr[0] += A.internalDcsr.numberOfNonEmptyRows;
+        localDcsr[1] += A.internalDcsr.numberOfRows;
+    }
+    if (A.externalFormat == FORMAT_DCSR) {
+        localDcsr[0] += A.externalDcsr.numberOfNonEmptyRows;
+        localDcsr[1] += A.externalDcsr.numberOfRows;
+    }
+    MPI_Reduce(localDcsr, dcsr, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    // kernels chosen by the autotuner : (internal format, schedule, external format, schedule)
+    int localKernel[4] = {A.internalFormat, A.internalSchedule, A.externalFormat, A.externalSchedule};
+    vector<int> kernel(rank == 0 ? 4 * size : 0);
+    if (autotuned) MPI_Gather(localKernel, 4, MPI_INT, kernel.data(), 4, MPI_INT, 0, MPI_COMM_WORLD);
+    double maxAutotuneTime, maxMklInspectionTime;
+    MPI_Reduce(&autotuneTime, &maxAutotuneTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&mklInspectionTime, &maxMklInspectionTime, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    int localRankReordered = A.halo->rankReordered, rankReordered;
+    MPI_Reduce(&localRankReordered, &rankReordered, 1, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    // sent entries that are packed into sendBuffer (the others go straight from x)
+    long long localSend[2] = {A.halo->numberOfPackedSend, A.totalNumberOfSend}, send[2];
+    MPI_Reduce(localSend, send, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    // bandwidth of the internal blocks : the largest over the ranks, profile : the sum
+    long long bandwidth[4];
+    if (reorder != REORDER_NONE) {
+        MPI_Reduce(localBandwidth, bandwidth, 2, MPI_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+        MPI_Reduce(localBandwidth + 2, bandwidth + 2, 2, MPI_LONG_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    }
     POUT("++++++++++++++++++++++++++++++++++++++++\n");
 #ifdef PRINT_HOSTNAME
     PrintHostName();
@@ -184,7 +458,7 @@ int main (int argc, char *argv[]) {
     PrintOption();
     if (rank == 0) {
         printf("%25s\t%s\n", "Matrix", mtxName.c_str());
-        printf("%25s\t%s\n", "Part", partName.c_str());
+        printf("%25s\t%s\n", "Part", ingest ? ("rows:" + rowDistribution).c_str() : partName.c_str());
         printf("%25s\t%d\n", "NumberOfProcesses", size);
 #pragma omp parallel 
         {
@@ -199,8 +473,69 @@ int main (int argc, char *argv[]) {
 #endif
         printf("%25s\t%d\n", "NumberOfRows", A.globalNumberOfRows);
         printf("%25s\t%d\n", "NumberOfNonzeros", A.globalNumberOfNonzeros);
+        printf("%25s\t%s\n", "Storage", A.symmetric ? "symmetric" : "general");
+        printf("%25s\t%lld\n", "StoredNonzeros", storedNonzeros);
+        printf("%25s\t%s\n", "HaloExchange", GetHaloMethodName(A.halo->method));
+        if (A.halo->method == HALO_NEIGHBOR) printf("%25s\t%d\n", "ReorderedRanks", rankReordered);
+        printf("%25s\t%s\n", "HaloPacking", GetPackMethodName(A.halo->packing));
+        if (A.halo->packing == PACK_BUFFER) printf("%25s\t%.4lf\n", "SendCopyFraction", send[1] ? (double) send[0] / send[1] : 0.0);
+        printf("%25s\t%s\n", "InternalFormat", GetStorageFormatName(A.internalFormat));
+        printf("%25s\t%s\n", "ExternalFormat", GetStorageFormatName(A.externalFormat));
+        if (sell[1]) printf("%25s\t%.4lf\n", "SellPadding", (double) (sell[0] - sell[1]) / sell[1]);
+        if (bcsr[1]) printf("%25s\t%.4lf\n", "BcsrFill", (double) bcsr[0] / bcsr[1]);
+        if (dcsr[1]) printf("%25s\t%.4lf\n", "DcsrRowFraction", (double) dcsr[0] / dcsr[1]);
+        if (reorder != REORDER_NONE) {
+            printf("%25s\t%s\n", "Reorder", GetReorderMethodName(reorder));
+            printf("%25s\t%lld\n", "BandwidthBefore", bandwidth[0]);
+            printf("%25s\t%lld\n", "BandwidthAfter", bandwidth[1]);
+            printf("%25s\t%lld\n", "ProfileBefore", bandwidth[2]);
+            printf("%25s\t%lld\n", "ProfileAfter", bandwidth[3]);
+        }
+        if (A.internalFormat == FORMAT_BCSR) printf("%25s\t%dx%d\n", "InternalBlock(rank0)", A.internalBcsr.r, A.internalBcsr.c);
+        if (A.externalFormat == FORMAT_BCSR) printf("%25s\t%dx%d\n", "ExternalBlock(rank0)", A.externalBcsr.r, A.externalBcsr.c);
+        if (autotuned) {
+            printf("%25s\t%.10lf\n", "AutotuneTime", maxAutotuneTime);
+            for (int r = 0; r < size; r++) {
+                char label[32];
+                sprintf(label, "Kernel(rank%d)", r);
+                printf("%25s\t%s/%s %s/%s\n", label,
+                        GetStorageFormatName(kernel[4*r]), GetLoopScheduleName(kernel[4*r+1]),
+                        GetStorageFormatName(kernel[4*r+2]), GetLoopScheduleName(kernel[4*r+3]));
+            }
+        }
 #ifdef PRINT_PERFORMANCE
         printf("%25s\t%.10lf\n", "GFLOPS", A.globalNumberOfNonzeros * 2 / timing[TIMING_TOTAL_SPMV] / 1e9);
+        if (nonCsr) {
+            printf("%25s\t%.10lf\n", "GFLOPS(CSR)", A.globalNumberOfNonzeros * 2 / csrTime / 1e9);
+        }
+        if (p2pTime > 0) printf("%25s\t%.10lf\n", "GFLOPS(p2p)", A.globalNumberOfNonzeros * 2 / p2pTime / 1e9);
+        if (bufferTime > 0) printf("%25s\t%.10lf\n", "GFLOPS(buffer)", A.globalNumberOfNonzeros * 2 / bufferTime / 1e9);
+        if (unorderedTime > 0) {
+            printf("%25s\t%.10lf\n", "GFLOPS(CSR,unordered)", A.globalNumberOfNonzeros * 2 / unorderedTime / 1e9);
+            printf("%25s\t%.10lf\n", "GFLOPS(CSR,reordered)", A.globalNumberOfNonzeros * 2 / reorderedTime / 1e9);
+            printf("%25s\t%.4lf\n", "ReorderSpeedup", unorderedTime / reorderedTime);
+        }
+        for (size_t n = 0; n < spmmVectors.size(); n++) {
+            char label[32];
+            sprintf(label, "GFLOPS(SpMM k=%d)", spmmVectors[n]);
+            printf("%25s\t%.10lf\n", label, A.globalNumberOfNonzeros * 2.0 * spmmVectors[n] / spmmTime[n] / 1e9);
+        }
+        if (transpose) printf("%25s\t%.10lf\n", "GFLOPS(Transpose)", A.globalNumberOfNonzeros * 2 / transposeTime / 1e9);
+        if (mpkSteps > 0) {
+            printf("%25s\t%d\n", "MpkSteps", mpkSteps);
+            printf("%25s\t%lld\n", "MpkGhostRows", mpkGhostRows);
+            printf("%25s\t%.4lf\n", "MpkRedundancy", (double) mpkRedundantNonzeros / ((double) A.globalNumberOfNonzeros * mpkSteps));
+            printf("%25s\t%.10lf\n", "MatrixPowers", mpkTime);
+            printf("%25s\t%.10lf\n", "SpMVxSteps", mpkSpMVTime);
+        }
+        if (mklHandles) {
+            // number of SpMV needed to pay for the inspection
+            const double gain = legacyTime - timing[TIMING_TOTAL_SPMV];
+            printf("%25s\t%.10lf\n", "GFLOPS(mkl_dcsrmv)", A.globalNumberOfNonzeros * 2 / legacyTime / 1e9);
+            printf("%25s\t%.10lf\n", "MklInspection", maxMklInspectionTime);
+            printf("%25s\t%.10lf\n", "MklGainPerSpMV", gain);
+            if (gain > 0) printf("%25s\t%.1lf\n", "MklBreakEvenSpMV", maxMklInspectionTime / gain);
+        }
         printf("%25s\t%d\n", "nLoop", nLoop);
         for (int i = 0; i < NUMBER_OF_TIMING; i++) {
             if (timingDetail[i] != NULL) {
@@ -212,6 +547,7 @@ int main (int argc, char *argv[]) {
     POUT("----------------------------------------\n");
     PERR("done\n");
     PERR("Finalizing ... ");
+    DeleteHaloExchange(A);
     MPI_Finalize();
     PERR("done\n");
     PERR("Complete!!\n");
@@ -0,0 +1,254 @@
+#include <mpi.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "matrix_powers.h"
+using namespace std;
+
+// Alltoallv of the requests (grouped by the destination), count[r] items go to rank r
+template<class T>
+static void ExchangeByRank (const vector<T> &send, const vector<int> &sendCount, vector<T> &recv, vector<int> &recvCount, MPI_Datatype type) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    recvCount.resize(size);
+    MPI_Alltoall(sendCount.data(), 1, MPI_INT, recvCount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    vector<int> sendDispl(size + 1, 0), recvDispl(size + 1, 0);
+    for (int r = 0; r < size; r++) {
+        sendDispl[r+1] = sendDispl[r] + sendCount[r];
+        recvDispl[r+1] = recvDispl[r] + recvCount[r];
+    }
+    recv.resize(recvDispl[size]);
+    MPI_Alltoallv(send.data(), sendCount.data(), sendDispl.data(), type,
+            recv.data(), recvCount.data(), recvDispl.data(), type, MPI_COMM_WORLD);
+}
+
+// Group the global rows by the owner : order[i] = position of rows[i] in the grouped list
+static void GroupByOwner (const SparseMatrix &A, const vector<int> &rows, vector<int> &grouped, vector<int> &count, vector<int> &order) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    vector<int> owners;
+    LookupOwners(A.rowOwner, rows, owners);
+    count.assign(size, 0);
+    for (size_t i = 0; i < rows.size(); i++) count[owners[i]]++;
+    vector<int> cursor(size, 0);
+    for (int r = 1; r < size; r++) cursor[r] = cursor[r-1] + count[r-1];
+    grouped.resize(rows.size());
+    order.resize(rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        order[i] = cursor[owners[i]]++;
+        grouped[order[i]] = rows[i];
+    }
+}
+
+// Fetch the rows (global column indices) from their owners and append them to ptr/col/val
+static void FetchRows (const SparseMatrix &A, const vector<int> &rows, vector<int> &ptr, vector<int> &col, vector<double> &val) {
+    vector<int> grouped, count, order;
+    GroupByOwner(A, rows, grouped, count, order);
+    vector<int> requested, requestedCount;
+    ExchangeByRank(grouped, count, requested, requestedCount, MPI_INT);
+
+    // the owners answer with the lengths, then the entries of the rows
+    vector<int> length(requested.size()), answerCol, answerCount(requestedCount.size(), 0);
+    vector<double> answerVal;
+    for (int r = 0, q = 0; r < (int) requestedCount.size(); r++) {
+        for (int e = 0; e < requestedCount[r]; e++, q++) {
+            const int i = GlobalToLocal(A.global2local, requested[q]);
+            if (i < 0 || i >= A.localNumberOfRows) {
+                cerr << "Row " << requested[q] << " is not owned" << endl;
+                MPI_Abort(MPI_COMM_WORLD, 1);
+            }
+            length[q] = A.internalPtr[i+1] - A.internalPtr[i] + A.externalPtr[i+1] - A.externalPtr[i];
+            for (int j = A.internalPtr[i]; j < A.internalPtr[i+1]; j++) {
+                answerCol.push_back(A.local2global[A.internalIdx[j]]);
+                answerVal.push_back(A.internalVal[j]);
+            }
+            for (int j = A.externalPtr[i]; j < A.externalPtr[i+1]; j++) {
+                answerCol.push_back(A.local2global[A.externalIdx[j]]);
+                answerVal.push_back(A.externalVal[j]);
+            }
+            answerCount[r] += length[q];
+        }
+    }
+    vector<int> fetchedLength, dummy, fetchedCol, fetchedCount;
+    vector<double> fetchedVal;
+    ExchangeByRank(length, requestedCount, fetchedLength, dummy, MPI_INT);
+    ExchangeByRank(answerCol, answerCount, fetchedCol, fetchedCount, MPI_INT);
+    ExchangeByRank(answerVal, answerCount, fetchedVal, fetchedCount, MPI_DOUBLE);
+
+    vector<long long> offset(fetchedLength.size() + 1, 0);
+    for (size_t q = 0; q < fetchedLength.size(); q++) offset[q+1] = offset[q] + fetchedLength[q];
+    for (size_t i = 0; i < rows.size(); i++) {
+        const int q = order[i];
+        col.insert(col.end(), fetchedCol.begin() + offset[q], fetchedCol.begin() + offset[q+1]);
+        val.insert(val.end(), fetchedVal.begin() + offset[q], fetchedVal.begin() + offset[q+1]);
+        ptr.push_back(col.size());
+    }
+}
+
+void CreateMatrixPowersPlan (MatrixPowersPlan &P, const SparseMatrix &A, int numberOfSteps) {
+    const int k = numberOfSteps;
+    const int nLocal = A.localNumberOfRows;
+    P.numberOfSteps = k;
+    P.numberOfLocalRows = nLocal;
+    P.levelEnd = new int[k + 1];
+
+    //--------------------------------------------------------------------------------
+    // Levels : the local rows and the external columns of A are the levels 0 and 1
+    //--------------------------------------------------------------------------------
+    vector<int> extendedToGlobal(A.local2global, A.local2global + A.totalNumberOfUsedCols);
+    vector<int> ptr(1, 0), col;
+    vector<double> val;
+    for (int i = 0; i < nLocal; i++) {
+        for (int j = A.internalPtr[i]; j < A.internalPtr[i+1]; j++) {
+            col.push_back(A.local2global[A.internalIdx[j]]);
+            val.push_back(A.internalVal[j]);
+        }
+        for (int j = A.externalPtr[i]; j < A.externalPtr[i+1]; j++) {
+            col.push_back(A.local2global[A.externalIdx[j]]);
+            val.push_back(A.externalVal[j]);
+        }
+        ptr.push_back(col.size());
+    }
+    P.levelEnd[0] = nLocal;
+    P.levelEnd[1] = A.totalNumberOfUsedCols;
+    for (int l = 1; l < k; l++) {
+        vector<int> rows(extendedToGlobal.begin() + P.levelEnd[l-1], extendedToGlobal.begin() + P.levelEnd[l]);
+        const int first = col.size();
+        FetchRows(A, rows, ptr, col, val);
+        GlobalToLocalTable known;
+        CreateGlobalToLocalTable(known, extendedToGlobal.data(), extendedToGlobal.size());
+        vector<int> next;
+        for (int j = first; j < (int) col.size(); j++) {
+            if (GlobalToLocal(known, col[j]) < 0) next.push_back(col[j]);
+        }
+        DeleteGlobalToLocalTable(known);
+        sort(next.begin(), next.end());
+        next.erase(unique(next.begin(), next.end()), next.end());
+        extendedToGlobal.insert(extendedToGlobal.end(), next.begin(), next.end());
+        P.levelEnd[l+1] = extendedToGlobal.size();
+    }
+    const int nExtended = extendedToGlobal.size();
+    const int nRow = P.levelEnd[k-1];
+    P.extendedToGlobal = new int[nExtended];
+    copy(extendedToGlobal.begin(), extendedToGlobal.end(), P.extendedToGlobal);
+    P.ptr = new int[nRow + 1];
+    copy(ptr.begin(), ptr.end(), P.ptr);
+    P.idx = new int[col.size()];
+    P.val = new double[val.size()];
+    copy(val.begin(), val.end(), P.val);
+    GlobalToLocalTable extended;
+    CreateGlobalToLocalTable(extended, P.extendedToGlobal, nExtended);
+    TranslateGlobalToLocal(extended, col.data(), P.idx, col.size());
+    DeleteGlobalToLocalTable(extended);
+    P.numberOfRedundantNonzeros = 0;
+    for (int s = 1; s <= k; s++) P.numberOfRedundantNonzeros += P.ptr[P.levelEnd[k-s]] - P.ptr[nLocal];
+
+    //--------------------------------------------------------------------------------
+    // Exchange : the ghost values of all the levels come from their owners
+    //--------------------------------------------------------------------------------
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    vector<int> ghosts(extendedToGlobal.begin() + nLocal, extendedToGlobal.end());
+    vector<int> grouped, recvCount, order;
+    GroupByOwner(A, ghosts, grouped, recvCount, order);
+    vector<int> requested, sendCount;
+    ExchangeByRank(grouped, recvCount, requested, sendCount, MPI_INT);
+    P.totalNumberOfRecv = ghosts.size();
+    P.totalNumberOfSend = requested.size();
+    P.numberOfRecvNeighbors = size - count(recvCount.begin(), recvCount.end(), 0);
+    P.numberOfSendNeighbors = size - count(sendCount.begin(), sendCount.end(), 0);
+    P.recvNeighbors = new int[P.numberOfRecvNeighbors];
+    P.recvLength = new int[P.numberOfRecvNeighbors];
+    P.sendNeighbors = new int[P.numberOfSendNeighbors];
+    P.sendLength = new int[P.numberOfSendNeighbors];
+    for (int r = 0, rk = 0, sk = 0; r < size; r++) {
+        if (recvCount[r]) {
+            P.recvNeighbors[rk] = r;
+            P.recvLength[rk++] = recvCount[r];
+        }
+        if (sendCount[r]) {
+            P.sendNeighbors[sk] = r;
+            P.sendLength[sk++] = sendCount[r];
+        }
+    }
+    P.extendedIndexOfRecv = new int[P.totalNumberOfRecv];
+    for (size_t i = 0; i < ghosts.size(); i++) P.extendedIndexOfRecv[order[i]] = nLocal + i;
+    P.localIndexOfSend = new int[P.totalNumberOfSend];
+    TranslateGlobalToLocal(A.global2local, requested.data(), P.localIndexOfSend, P.totalNumberOfSend);
+    P.sendBuffer = new double[P.totalNumberOfSend];
+    P.recvBuffer = new double[P.totalNumberOfRecv];
+    P.values = new double[(long long) (k + 1) * nExtended];
+}
+
+void DeleteMatrixPowersPlan (MatrixPowersPlan &P) {
+    delete [] P.levelEnd;
+    delete [] P.extendedToGlobal;
+    delete [] P.ptr;
+    delete [] P.idx;
+    delete [] P.val;
+    delete [] P.sendNeighbors;
+    delete [] P.recvNeighbors;
+    delete [] P.sendLength;
+    delete [] P.recvLength;
+    delete [] P.localIndexOfSend;
+    delete [] P.extendedIndexOfRecv;
+    delete [] P.sendBuffer;
+    delete [] P.recvBuffer;
+    delete [] P.values;
+}
+
+void MatrixPowers (MatrixPowersPlan &P, const double *x) {
+    const int k = P.numberOfSteps;
+    const int nLocal = P.numberOfLocalRows;
+    const int stride = P.levelEnd[k];
+    double *x0 = P.values;
+    //==============================
+    // Exchange
+    //==============================
+#pragma omp parallel for
+    for (int i = 0; i < P.totalNumberOfSend; i++) P.sendBuffer[i] = x[P.localIndexOfSend[i]];
+    const int MPI_MY_TAG = 223606797;
+    MPI_Request *recvRequests = new MPI_Request[P.numberOfRecvNeighbors];
+    MPI_Request *sendRequests = new MPI_Request[P.numberOfSendNeighbors];
+    double *recvBuffer = P.recvBuffer, *sendBuffer = P.sendBuffer;
+    for (int i = 0; i < P.numberOfRecvNeighbors; i++) {
+        MPI_Irecv(recvBuffer, P.recvLength[i], MPI_DOUBLE, P.recvNeighbors[i], MPI_MY_TAG, MPI_COMM_WORLD, &recvRequests[i]);
+        recvBuffer += P.recvLength[i];
+    }
+    for (int i = 0; i < P.numberOfSendNeighbors; i++) {
+        MPI_Isend(sendBuffer, P.sendLength[i], MPI_DOUBLE, P.sendNeighbors[i], MPI_MY_TAG, MPI_COMM_WORLD, &sendRequests[i]);
+        sendBuffer += P.sendLength[i];
+    }
+    copy(x, x + nLocal, x0);
+    if (P.numberOfRecvNeighbors) {
+        if (MPI_Waitall(P.numberOfRecvNeighbors, recvRequests, MPI_STATUSES_IGNORE)) {
+            std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
+            std::exit(-1);
+        }
+    }
+#pragma omp parallel for
+    for (int i = 0; i < P.totalNumberOfRecv; i++) x0[P.extendedIndexOfRecv[i]] = P.recvBuffer[i];
+    //==============================
+    // Steps, the ghost region shrinks by one level each
+    //==============================
+    for (int s = 1; s <= k; s++) {
+        const double *in = P.values + (long long) (s - 1) * stride;
+        double *out = P.values + (long long) s * stride;
+        const int nRow = P.levelEnd[k-s];
+#pragma omp parallel for
+        for (int i = 0; i < nRow; i++) {
+            double sum = 0;
+            for (int j = P.ptr[i]; j < P.ptr[i+1]; j++) sum += P.val[j] * in[P.idx[j]];
+            out[i] = sum;
+        }
+    }
+    if (P.numberOfSendNeighbors) {
+        if (MPI_Waitall(P.numberOfSendNeighbors, sendRequests, MPI_STATUSES_IGNORE)) {
+            std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
+            std::exit(-1);
+        }
+    }
+    delete [] recvRequests;
+    delete [] sendRequests;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "sparse_matrix.h"
+
+//------------------------------------------
+// Matrix powers kernel (x, Ax, ..., A^k x with one halo exchange)
+//------------------------------------------
+// The local rows are extended by k levels of ghost rows: level 1 is the external
+// columns of A, level l + 1 the new columns of the rows of level l. Extended row r is
+// local (r < levelEnd[0]) or in level l ([levelEnd[l-1], levelEnd[l])). The rows of
+// the levels 0 .. k-1 are copied from their owners, so after x has been exchanged on
+// all the levels, step s computes the rows [0, levelEnd[k-s]) redundantly.
+struct MatrixPowersPlan {
+    int numberOfSteps;              // k
+    int numberOfLocalRows;
+    int *levelEnd;                  // [k + 1]
+    int *extendedToGlobal;          // [levelEnd[k]]
+    int *ptr;                       // [levelEnd[k-1] + 1]
+    int *idx;                       // extended column indices
+    double *val;
+    long long numberOfRedundantNonzeros;    // multiplied by the ghost rows over the k steps
+
+    // one exchange for all the ghost levels
+    int numberOfSendNeighbors;
+    int numberOfRecvNeighbors;
+    int *sendNeighbors;
+    int *recvNeighbors;
+    int *sendLength;
+    int *recvLength;
+    int totalNumberOfSend;
+    int totalNumberOfRecv;
+    int *localIndexOfSend;
+    int *extendedIndexOfRecv;
+    double *sendBuffer;
+    double *recvBuffer;
+
+    // A^s x of the extended rows at values + s * levelEnd[k]
+    double *values;
+};
+
+// Collective, A must not be in symmetric storage
+void CreateMatrixPowersPlan (MatrixPowersPlan &P, const SparseMatrix &A, int numberOfSteps);
+void DeleteMatrixPowersPlan (MatrixPowersPlan &P);
+// x : local values. A^s x of the local rows is at GetMatrixPower(P, s) afterwards.
+void MatrixPowers (MatrixPowersPlan &P, const double *x);
+
+inline const double* GetMatrixPower (const MatrixPowersPlan &P, int s) {
+    return P.values + (long long) s * P.levelEnd[P.numberOfSteps];
+}
@@ -0,0 +1,64 @@
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "merge_path.h"
+using namespace std;
+
+// Coordinate (row, nonzero) where the diagonal d crosses the merge path
+static void SearchMergePath (int d, int nRow, const int *ptr, int &row, int &nnz) {
+    const int nNnz = ptr[nRow];
+    int lo = max(0, d - nNnz), hi = min(d, nRow);
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (ptr[mid+1] <= d - 1 - mid) lo = mid + 1;
+        else hi = mid;
+    }
+    row = lo;
+    nnz = d - lo;
+}
+
+void CreateMergePathSchedule (MergePathSchedule &M, int nRow, const int *ptr) {
+#ifdef _OPENMP
+    M.numberOfThreads = omp_get_max_threads();
+#else
+    M.numberOfThreads = 1;
+#endif
+    const int T = M.numberOfThreads;
+    M.rowBegin = new int[T + 1];
+    M.nnzBegin = new int[T + 1];
+    M.carry = new double[T];
+    const long long total = (long long) nRow + ptr[nRow];
+    for (int t = 0; t <= T; t++) {
+        SearchMergePath((int) (total * t / T), nRow, ptr, M.rowBegin[t], M.nnzBegin[t]);
+    }
+}
+
+void DeleteMergePathSchedule (MergePathSchedule &M) {
+    delete [] M.rowBegin;
+    delete [] M.nnzBegin;
+    delete [] M.carry;
+    M.rowBegin = M.nnzBegin = NULL;
+    M.carry = NULL;
+}
+
+void MergePathMV (const MergePathSchedule &M, int nRow, const int *ptr, const int *idx, const double *val, const double *x, double *y, bool accumulate) {
+    // one segment per iteration : every segment (and its carry) is done whatever the team size
+#pragma omp parallel for schedule(static, 1) num_threads(M.numberOfThreads)
+    for (int t = 0; t < M.numberOfThreads; t++) {
+        int row = M.rowBegin[t], k = M.nnzBegin[t];
+        const int rowEnd = M.rowBegin[t+1], nnzEnd = M.nnzBegin[t+1];
+        double sum = 0;
+        for (; row < rowEnd; row++) {
+            for (; k < ptr[row+1]; k++) sum += val[k] * x[idx[k]];
+            y[row] = accumulate ? y[row] + sum : sum;
+            sum = 0;
+        }
+        // the row continues in the next segment
+        for (; k < nnzEnd; k++) sum += val[k] * x[idx[k]];
+        M.carry[t] = sum;
+    }
+    for (int t = 0; t < M.numberOfThreads; t++) {
+        if (M.rowBegin[t+1] < nRow) y[M.rowBegin[t+1]] += M.carry[t];
+    }
+}
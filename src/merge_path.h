@@ -0,0 +1,20 @@
+#pragma once
+
+//------------------------------------------
+// Merge path CSR SpMV
+//------------------------------------------
+// The merged sequence of the row ends (ptr[1..nRow]) and the nonzeros is split evenly
+// among the threads, so that every thread gets about (nRow + nnz) / nThread items
+// regardless of the row lengths. Thread t starts at row rowBegin[t], nonzero nnzBegin[t].
+// A row split between threads is finished by adding the partial sums (carry) at the end.
+struct MergePathSchedule {
+    int numberOfThreads;
+    int *rowBegin;      // [numberOfThreads + 1]
+    int *nnzBegin;      // [numberOfThreads + 1]
+    double *carry;      // [numberOfThreads]
+};
+
+void CreateMergePathSchedule (MergePathSchedule &M, int nRow, const int *ptr);
+void DeleteMergePathSchedule (MergePathSchedule &M);
+// y = A x (accumulate == false) or y += A x (accumulate == true)
+void MergePathMV (const MergePathSchedule &M, int nRow, const int *ptr, const int *idx, const double *val, const double *x, double *y, bool accumulate);
@@ -9,10 +9,23 @@
 #include <cstring>
 #include <cstdio>
 #include <cmath>
+#include <limits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "mpi_util.h"
 #include "sparse_matrix.h"
 #include "vector.h"
 #include "util.h"
+#include "binary_part.h"
+#include "halo_plan.h"
+#include "halo_exchange.h"
+#include "spmv_kernel.h"
+#include "csr_kernel.h"
 #ifdef GPU
 #include <cuda_runtime_api.h>
 #include <cusparse_v2.h>
@@ -40,6 +53,16 @@ void PrintHostName () {
     delete [] buf;
 }
 
+// Part file without the communication plan : the owners of the external columns are
+// found in the ownership directory and the plan is built at runtime
+static void BuildHaloPlanWithDirectory (SparseMatrix &A, int nLocal, const int *localRowGlobal, const int *ptr, const int *globalCol, const double *val) {
+    CreateOwnershipDirectory(A.rowOwner, A.globalNumberOfRows, localRowGlobal, nLocal);
+    const OwnershipDirectory &rowOwner = A.rowOwner;
+    BuildHaloPlan(A, nLocal, localRowGlobal, ptr, globalCol, val, [&rowOwner](const vector<int> &rows, vector<int> &owners) {
+        LookupOwners(rowOwner, rows, owners);
+    });
+}
+
 void LoadInput (const string &partFile, SparseMatrix &A, Vector &x) {
     ifstream ifs(partFile);
     if (ifs.fail()) {
@@ -62,23 +85,59 @@ void LoadInput (const string &partFile, SparseMatrix &A, Vector &x) {
     assert(nProc == size);
     assert(A.globalNumberOfRows == nCol);
 
-    //--------------------------------------------------------------------------------
-    // Partitioning
-    //--------------------------------------------------------------------------------
-    ifs >> comment; assert(comment == "#Partitioning");
-    A.assign = new int[A.globalNumberOfRows];
-    for (int i = 0; i < A.globalNumberOfRows; i++) ifs >> A.assign[i];
+    ifs >> comment;
+    A.symmetric = comment == "#Symmetric";
+    if (A.symmetric) ifs >> comment;
 
     //--------------------------------------------------------------------------------
     // Local <-> global map
     //--------------------------------------------------------------------------------
-    ifs >> comment; assert(comment == "#LocalToGlobalTable");
+    if (comment == "#Partitioning") {
+        // files written by older versions replicate the partitioning, it is not needed
+        ifs.ignore(numeric_limits<streamsize>::max(), '\n');
+        ifs.ignore(numeric_limits<streamsize>::max(), '\n');
+        ifs >> comment;
+    }
+    if (comment == "#LocalRows") {
+        int nLocal;
+        ifs >> nLocal;
+        vector<int> localRowGlobal(nLocal);
+        for (int i = 0; i < nLocal; i++) ifs >> localRowGlobal[i];
+        ifs >> comment; assert(comment == "#SubMatrix");
+        int numInternalNnz, numExternalNnz;
+        ifs >> A.localNumberOfRows >> numInternalNnz >> numExternalNnz;
+        assert(A.localNumberOfRows == nLocal);
+        const int nNnz = numInternalNnz + numExternalNnz;
+        vector<int> rows(nNnz), cols(nNnz);
+        vector<double> vals(nNnz);
+        for (int i = 0; i < nNnz; i++) ifs >> rows[i] >> cols[i] >> vals[i];
+
+        // counting sort by row, internal entries stay in front of the external ones
+        GlobalToLocalTable localRows;
+        CreateGlobalToLocalTable(localRows, localRowGlobal.data(), nLocal);
+        TranslateGlobalToLocal(localRows, rows.data(), rows.data(), nNnz);
+        DeleteGlobalToLocalTable(localRows);
+        vector<int> ptr(nLocal + 1, 0), col(nNnz);
+        vector<double> val(nNnz);
+        for (int i = 0; i < nNnz; i++) ptr[rows[i] + 1]++;
+        for (int i = 0; i < nLocal; i++) ptr[i+1] += ptr[i];
+        vector<int> cursor(ptr.begin(), ptr.end() - 1);
+        for (int i = 0; i < nNnz; i++) {
+            int j = cursor[rows[i]]++;
+            col[j] = cols[i];
+            val[j] = vals[i];
+        }
+        BuildHaloPlanWithDirectory(A, nLocal, localRowGlobal.data(), ptr.data(), col.data(), val.data());
+        CompleteLoadInput(A, x);
+        return;
+    }
+    assert(comment == "#LocalToGlobalTable");
     ifs >> A.totalNumberOfUsedCols;
     A.local2global = new int[A.totalNumberOfUsedCols];
     for (int i = 0; i < A.totalNumberOfUsedCols; i++) {
         ifs >> A.local2global[i];
-        A.global2local[A.local2global[i]] = i;
     }
+    CreateGlobalToLocalTable(A.global2local, A.local2global, A.totalNumberOfUsedCols);
     //--------------------------------------------------------------------------------
     // SubMatrix
     //--------------------------------------------------------------------------------
@@ -89,34 +148,31 @@ void LoadInput (const string &partFile, SparseMatrix &A, Vector &x) {
     A.internalPtr = new int[A.localNumberOfRows + 1];
     A.internalIdx = new int[numInternalNnz];
     A.internalVal = new double[numInternalNnz];
+    A.externalPtr = new int[A.localNumberOfRows + 1];
+    A.externalIdx = new int[numExternalNnz];
+    A.externalVal = new double[numExternalNnz];
     {
+        // rows and cols are read as global indices and translated at once
+        vector<int> rows(numInternalNnz + numExternalNnz);
+        int *internalRow = rows.data(), *externalRow = internalRow + numInternalNnz;
+        for (int i = 0; i < numInternalNnz; i++) {
+            ifs >> internalRow[i] >> A.internalIdx[i] >> A.internalVal[i];
+        }
+        for (int i = 0; i < numExternalNnz; i++) {
+            ifs >> externalRow[i] >> A.externalIdx[i] >> A.externalVal[i];
+        }
+        TranslateGlobalToLocal(A.global2local, rows.data(), rows.data(), rows.size());
+        TranslateGlobalToLocal(A.global2local, A.internalIdx, A.internalIdx, numInternalNnz);
+        TranslateGlobalToLocal(A.global2local, A.externalIdx, A.externalIdx, numExternalNnz);
+
         int ip = 0;
         for (int i = 0; i < numInternalNnz; i++) {
-            int row, col;
-            double val;
-            ifs >> row >> col >> val;
-            row = A.global2local[row];
-            col = A.global2local[col];
-            A.internalIdx[i] = col;
-            A.internalVal[i] = val;
-            while (ip <= row) A.internalPtr[ip++] = i;
+            while (ip <= internalRow[i]) A.internalPtr[ip++] = i;
         }
         while (ip <= A.localNumberOfRows) A.internalPtr[ip++] = numInternalNnz;
-    }
-    A.externalPtr = new int[A.localNumberOfRows + 1];
-    A.externalIdx = new int[numExternalNnz];
-    A.externalVal = new double[numExternalNnz];
-    {
         int ep = 0;
         for (int i = 0; i < numExternalNnz; i++) {
-            int row, col;
-            double val;
-            ifs >> row >> col >> val;
-            row = A.global2local[row];
-            col = A.global2local[col];
-            A.externalIdx[i] = col;
-            A.externalVal[i] = val;
-            while (ep <= row) A.externalPtr[ep++] = i;
+            while (ep <= externalRow[i]) A.externalPtr[ep++] = i;
         }
         while (ep <= A.localNumberOfRows) A.externalPtr[ep++] = numExternalNnz;
     }
@@ -157,11 +213,207 @@ void LoadInput (const string &partFile, SparseMatrix &A, Vector &x) {
         recvOffset += A.recvLength[i];
     }
     assert(recvOffset == A.totalNumberOfRecv);
+    CreateOwnershipDirectory(A.rowOwner, A.globalNumberOfRows, A.local2global, A.localNumberOfRows);
+    CompleteLoadInput(A, x);
+}
+
+bool ExistsFile (const string &file) {
+    struct stat st;
+    return stat(file.c_str(), &st) == 0;
+}
+
+// The sections of the file are used in place, the mapping is kept until the process exits.
+// MAP_PRIVATE makes the arrays writable without touching the file.
+void LoadBinaryInput (const string &binaryPartFile, SparseMatrix &A, Vector &x) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    int fd = open(binaryPartFile.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "File not found : " + binaryPartFile << std::endl;
+        exit(1);
+    }
+    struct stat st;
+    fstat(fd, &st);
+    if (st.st_size < (off_t)sizeof(BinaryPartHeader)) {
+        std::cerr << "Broken binary part file : " + binaryPartFile << std::endl;
+        exit(1);
+    }
+    char *base = (char *) mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        std::cerr << "mmap failed : " + binaryPartFile << std::endl;
+        exit(1);
+    }
+    const BinaryPartHeader &header = *(const BinaryPartHeader *) base;
+    if (memcmp(header.magic, BINARY_PART_MAGIC, sizeof(header.magic)) != 0 
+            || header.version != BINARY_PART_VERSION 
+            || header.headerSize != sizeof(BinaryPartHeader)) {
+        std::cerr << "Unsupported binary part file (expected version " << BINARY_PART_VERSION << ") : " + binaryPartFile << std::endl;
+        exit(1);
+    }
+    for (int s = 0; s < NUMBER_OF_SECTIONS; s++) {
+        assert(header.sectionOffset[s] % BINARY_PART_ALIGNMENT == 0);
+        if (header.sectionOffset[s] + header.sectionLength[s] > st.st_size) {
+            std::cerr << "Broken binary part file : " + binaryPartFile << std::endl;
+            exit(1);
+        }
+    }
+    assert(header.numberOfParts == size);
+    assert(header.partId == rank);
+    assert(header.globalNumberOfRows == header.globalNumberOfCols);
+#define SECTION(type, s) ((type *) (base + header.sectionOffset[s]))
+    A.globalNumberOfRows = header.globalNumberOfRows;
+    A.globalNumberOfNonzeros = header.globalNumberOfNonzeros;
+    A.localNumberOfRows = header.localNumberOfRows;
+    A.localNumberOfNonzeros = header.numberOfInternalNonzeros + header.numberOfExternalNonzeros;
+    A.symmetric = header.symmetric;
+    if (!header.hasCommunication) {
+        // internal columns are local (= local rows), external columns are global
+        const int nLocal = header.localNumberOfRows;
+        const int *localRowGlobal = SECTION(int, SECTION_LOCAL_TO_GLOBAL);
+        const int *internalPtr = SECTION(int, SECTION_INTERNAL_PTR);
+        const int *internalIdx = SECTION(int, SECTION_INTERNAL_IDX);
+        const double *internalVal = SECTION(double, SECTION_INTERNAL_VAL);
+        const int *externalPtr = SECTION(int, SECTION_EXTERNAL_PTR);
+        const int *externalIdx = SECTION(int, SECTION_EXTERNAL_IDX);
+        const double *externalVal = SECTION(double, SECTION_EXTERNAL_VAL);
+        vector<int> ptr(nLocal + 1), col(A.localNumberOfNonzeros);
+        vector<double> val(A.localNumberOfNonzeros);
+        ptr[0] = 0;
+        for (int i = 0, n = 0; i < nLocal; i++) {
+            for (int j = internalPtr[i]; j < internalPtr[i+1]; j++, n++) {
+                col[n] = localRowGlobal[internalIdx[j]];
+                val[n] = internalVal[j];
+            }
+            for (int j = externalPtr[i]; j < externalPtr[i+1]; j++, n++) {
+                col[n] = externalIdx[j];
+                val[n] = externalVal[j];
+            }
+            ptr[i+1] = n;
+        }
+        BuildHaloPlanWithDirectory(A, nLocal, localRowGlobal, ptr.data(), col.data(), val.data());
+        CompleteLoadInput(A, x);
+        return;
+    }
+
+    A.totalNumberOfUsedCols = header.totalNumberOfUsedCols;
+    A.local2global = SECTION(int, SECTION_LOCAL_TO_GLOBAL);
+    CreateGlobalToLocalTable(A.global2local, A.local2global, A.totalNumberOfUsedCols);
+
+    A.internalPtr = SECTION(int, SECTION_INTERNAL_PTR);
+    A.internalIdx = SECTION(int, SECTION_INTERNAL_IDX);
+    A.internalVal = SECTION(double, SECTION_INTERNAL_VAL);
+    A.externalPtr = SECTION(int, SECTION_EXTERNAL_PTR);
+    A.externalIdx = SECTION(int, SECTION_EXTERNAL_IDX);
+    A.externalVal = SECTION(double, SECTION_EXTERNAL_VAL);
+
+    A.numberOfSendNeighbors = header.numberOfSendNeighbors;
+    A.totalNumberOfSend = header.totalNumberOfSend;
+    A.sendNeighbors = SECTION(int, SECTION_SEND_NEIGHBORS);
+    A.sendLength = SECTION(int, SECTION_SEND_LENGTH);
+    A.localIndexOfSend = SECTION(int, SECTION_LOCAL_INDEX_OF_SEND);
+    A.sendBuffer = new double[A.totalNumberOfSend];
+
+    A.numberOfRecvNeighbors = header.numberOfRecvNeighbors;
+    A.totalNumberOfRecv = header.totalNumberOfRecv;
+    A.recvNeighbors = SECTION(int, SECTION_RECV_NEIGHBORS);
+    A.recvLength = SECTION(int, SECTION_RECV_LENGTH);
+    A.localIndexOfRecv = SECTION(int, SECTION_LOCAL_INDEX_OF_RECV);
+#undef SECTION
+    CreateOwnershipDirectory(A.rowOwner, A.globalNumberOfRows, A.local2global, A.localNumberOfRows);
+    CompleteLoadInput(A, x, true);
+}
+
+// rowBegin[t] = first row of the thread t in the CSR kernel (see CsrMV)
+static void GetThreadRows (int nRow, const int *ptr, vector<int> &rowBegin) {
+#ifdef _OPENMP
+    const int nThread = omp_get_max_threads();
+#else
+    const int nThread = 1;
+#endif
+    rowBegin.resize(nThread + 1);
+    for (int t = 0; t <= nThread; t++) rowBegin[t] = GetCsrThreadRowBegin(nRow, ptr, t, nThread);
+}
+
+// The rows of a thread in the portable CSR kernel (CsrMV) are first touched by that thread, so
+// that its pages are on its NUMA node when the threads are bound (OMP_PROC_BIND). Only that
+// kernel's split is followed, see CompleteLoadInput for the limits. A block of the heap is copied
+// to new arrays. A section of the mapped binary part file is rewritten in place instead: the
+// first write to a MAP_PRIVATE page allocates its private copy on the node of the writer.
+static void FirstTouchBlock (int nRow, int *&ptr, int *&idx, double *&val, bool mapped) {
+    vector<int> rowBegin;
+    GetThreadRows(nRow, ptr, rowBegin);
+    const int nChunk = rowBegin.size() - 1;
+    if (mapped) {
+        volatile int *vPtr = ptr, *vIdx = idx;
+        volatile double *vVal = val;
+#pragma omp parallel for schedule(static, 1) num_threads(nChunk)
+        for (int t = 0; t < nChunk; t++) {
+            for (int i = rowBegin[t]; i < rowBegin[t+1]; i++) {
+                vPtr[i+1] = vPtr[i+1];
+                for (int j = vPtr[i]; j < vPtr[i+1]; j++) {
+                    vIdx[j] = vIdx[j];
+                    vVal[j] = vVal[j];
+                }
+            }
+        }
+        return;
+    }
+    int *newPtr = new int[nRow + 1];
+    int *newIdx = new int[ptr[nRow]];
+    double *newVal = new double[ptr[nRow]];
+    newPtr[0] = 0;
+#pragma omp parallel for schedule(static, 1) num_threads(nChunk)
+    for (int t = 0; t < nChunk; t++) {
+        for (int i = rowBegin[t]; i < rowBegin[t+1]; i++) {
+            newPtr[i+1] = ptr[i+1];
+            for (int j = ptr[i]; j < ptr[i+1]; j++) {
+                newIdx[j] = idx[j];
+                newVal[j] = val[j];
+            }
+        }
+    }
+    delete [] ptr;
+    delete [] idx;
+    delete [] val;
+    ptr = newPtr;
+    idx = newIdx;
+    val = newVal;
+}
+
+// Place the blocks, create x (x[i] = (global index of i) + 1, see VerifySpMV) and the halo exchange
+// and copy A to the device.
+// mapped : the blocks are sections of the binary part file.
+// The blocks and the local rows of x are placed once, here, by the row split of the portable CSR
+// kernel at load time. The placement is not redone when SPMV_REORDER permutes the rows or when
+// another format or backend is chosen (MKL, SELL chunks, merge-path segments, BCSR block rows,
+// the runtime schedule of DCSR): their pages stay where the CSR split put them. The halo region
+// of x has no owning thread and is left to the thread that first writes it.
+void CompleteLoadInput (SparseMatrix &A, Vector &x, bool mapped) {
+    FirstTouchBlock(A.localNumberOfRows, A.internalPtr, A.internalIdx, A.internalVal, mapped);
+    FirstTouchBlock(A.localNumberOfRows, A.externalPtr, A.externalIdx, A.externalVal, mapped);
     x.values = new double[A.totalNumberOfUsedCols];
-    for (int i = 0; i < A.localNumberOfRows; i++) {
-        x.values[i] = A.local2global[i] + 1;
+    // the local rows of x and y are touched like the rows of the internal block
+    vector<int> rowBegin;
+    GetThreadRows(A.localNumberOfRows, A.internalPtr, rowBegin);
+    const int nChunk = rowBegin.size() - 1;
+#pragma omp parallel for schedule(static, 1) num_threads(nChunk)
+    for (int t = 0; t < nChunk; t++) {
+        for (int i = rowBegin[t]; i < rowBegin[t+1]; i++) {
+            x.values[i] = A.local2global[i] + 1;
+        }
     }
     //fill(x.values, x.values + A.totalNumberOfUsedCols, 1);
+    CreateHaloExchange(A, GetHaloMethod(GetEnvOption("SPMV_HALO", "p2p")), GetPackMethod(GetEnvOption("SPMV_PACK", "buffer")),
+            GetEnvOption("SPMV_HALO_REORDER", "0") != "0");
+    if (A.symmetric) {
+#ifdef GPU
+        std::cerr << "Symmetric storage is not supported on GPU" << std::endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+        CreateScatterSchedule(A);
+    }
 #ifdef GPU
     int ip = A.internalPtr[A.localNumberOfRows];
     int ep = A.externalPtr[A.localNumberOfRows];
@@ -191,83 +443,168 @@ void CreateZeroVector (Vector &v, int length) {
     fill(v.values, v.values + length, 0);
 }
 
-void PrintResult (SparseMatrix &A, Vector &y) {
+// Zero vector of the local rows, first touched like x (see CompleteLoadInput)
+void CreateLocalVector (const SparseMatrix &A, Vector &y) {
+    y.values = new double[A.localNumberOfRows];
+    y.localLength = A.localNumberOfRows;
+    vector<int> rowBegin;
+    GetThreadRows(A.localNumberOfRows, A.internalPtr, rowBegin);
+    const int nChunk = rowBegin.size() - 1;
+#pragma omp parallel for schedule(static, 1) num_threads(nChunk)
+    for (int t = 0; t < nChunk; t++) {
+        fill(y.values + rowBegin[t], y.values + rowBegin[t+1], 0);
+    }
+}
+
+// Zero vectors with room for the external rows of A
+void CreateMultiVector (const SparseMatrix &A, MultiVector &X, int numberOfVectors) {
+    const int k = numberOfVectors;
+    X.localLength = A.localNumberOfRows;
+    X.externalLength = A.totalNumberOfUsedCols - A.localNumberOfRows;
+    X.numberOfVectors = k;
+    X.values = new double[(long long) A.totalNumberOfUsedCols * k];
+    X.sendBuffer = new double[(long long) A.totalNumberOfSend * k];
+    fill(X.values, X.values + (long long) A.totalNumberOfUsedCols * k, 0);
+    // the halo exchange of SpMM is bound to the vectors once
+    X.numberOfRecvRequests = A.numberOfRecvNeighbors;
+    X.numberOfSendRequests = A.numberOfSendNeighbors;
+    X.requests = new MPI_Request[A.numberOfRecvNeighbors + A.numberOfSendNeighbors];
+    double *recvBuffer = X.values + (long long) A.localNumberOfRows * k;
+    for (int i = 0; i < A.numberOfRecvNeighbors; i++) {
+        MPI_Recv_init(recvBuffer, A.recvLength[i] * k, MPI_DOUBLE, A.recvNeighbors[i], HALO_SPMM_TAG, MPI_COMM_WORLD, &X.requests[i]);
+        recvBuffer += (long long) A.recvLength[i] * k;
+    }
+    double *sendBuffer = X.sendBuffer;
+    for (int i = 0; i < A.numberOfSendNeighbors; i++) {
+        MPI_Send_init(sendBuffer, A.sendLength[i] * k, MPI_DOUBLE, A.sendNeighbors[i], HALO_SPMM_TAG, MPI_COMM_WORLD, &X.requests[A.numberOfRecvNeighbors + i]);
+        sendBuffer += (long long) A.sendLength[i] * k;
+    }
+}
+
+#define RESULT_TAG 316227766
+
+// y is routed to the home ranks of the ownership directory, then rank 0 receives the home blocks
+// one after the other and calls f(global row, owner, local index, value) for every row in order
+// (owner -1 and value 0 for a row without owner). Rank 0 keeps a single block at a time.
+template <class RowFunction>
+static void ForEachResultRow (const SparseMatrix &A, const Vector &y, RowFunction f) {
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
-    MPI_Barrier(MPI_COMM_WORLD);
-    for (int i = 0; i < A.globalNumberOfRows; i++) {
-        MPI_Barrier(MPI_COMM_WORLD);
-        if (A.assign[i] == rank) {
-            cerr << i << " " << rank << " " <<  A.global2local[i] << " " << y.values[A.global2local[i]] << endl;
+    const OwnershipDirectory &dir = A.rowOwner;
+    const int nLocal = A.localNumberOfRows;
+    vector<int> sendCount(size, 0), recvCount(size), sendDispl(size + 1, 0), recvDispl(size + 1, 0);
+    for (int i = 0; i < nLocal; i++) sendCount[GetHomeRank(dir, A.local2global[i])]++;
+    MPI_Alltoall(sendCount.data(), 1, MPI_INT, recvCount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0; r < size; r++) {
+        sendDispl[r+1] = sendDispl[r] + sendCount[r];
+        recvDispl[r+1] = recvDispl[r] + recvCount[r];
+    }
+    vector<int> sendRows(nLocal), sendLocal(nLocal), recvRows(recvDispl[size]), recvLocal(recvDispl[size]);
+    vector<double> sendValues(nLocal), recvValues(recvDispl[size]);
+    vector<int> cursor(sendDispl.begin(), sendDispl.end() - 1);
+    for (int i = 0; i < nLocal; i++) {
+        const int position = cursor[GetHomeRank(dir, A.local2global[i])]++;
+        sendRows[position] = A.local2global[i];
+        sendLocal[position] = i;
+        sendValues[position] = y.values[i];
+    }
+    MPI_Alltoallv(sendRows.data(), sendCount.data(), sendDispl.data(), MPI_INT,
+            recvRows.data(), recvCount.data(), recvDispl.data(), MPI_INT, MPI_COMM_WORLD);
+    MPI_Alltoallv(sendLocal.data(), sendCount.data(), sendDispl.data(), MPI_INT,
+            recvLocal.data(), recvCount.data(), recvDispl.data(), MPI_INT, MPI_COMM_WORLD);
+    MPI_Alltoallv(sendValues.data(), sendCount.data(), sendDispl.data(), MPI_DOUBLE,
+            recvValues.data(), recvCount.data(), recvDispl.data(), MPI_DOUBLE, MPI_COMM_WORLD);
+
+    int homeBegin, homeLength;
+    GetHomeRange(dir, rank, homeBegin, homeLength);
+    vector<int> owner(homeLength, -1), local(homeLength, -1);
+    vector<double> values(homeLength, 0);
+    for (int r = 0; r < size; r++) {
+        for (int i = recvDispl[r]; i < recvDispl[r+1]; i++) {
+            owner[recvRows[i] - homeBegin] = r;
+            local[recvRows[i] - homeBegin] = recvLocal[i];
+            values[recvRows[i] - homeBegin] = recvValues[i];
+        }
+    }
+    if (rank != 0) {
+        MPI_Send(owner.data(), homeLength, MPI_INT, 0, RESULT_TAG, MPI_COMM_WORLD);
+        MPI_Send(local.data(), homeLength, MPI_INT, 0, RESULT_TAG, MPI_COMM_WORLD);
+        MPI_Send(values.data(), homeLength, MPI_DOUBLE, 0, RESULT_TAG, MPI_COMM_WORLD);
+        return;
+    }
+    for (int h = 0; h < size; h++) {
+        GetHomeRange(dir, h, homeBegin, homeLength);
+        if (h) {
+            owner.resize(homeLength);
+            local.resize(homeLength);
+            values.resize(homeLength);
+            MPI_Recv(owner.data(), homeLength, MPI_INT, h, RESULT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Recv(local.data(), homeLength, MPI_INT, h, RESULT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Recv(values.data(), homeLength, MPI_DOUBLE, h, RESULT_TAG, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
         }
-        cerr.flush();
-        MPI_Barrier(MPI_COMM_WORLD);
+        for (int i = 0; i < homeLength; i++) f(homeBegin + i, owner[i], local[i], values[i]);
     }
 }
 
+void PrintResult (SparseMatrix &A, Vector &y) {
+    ForEachResultRow(A, y, [] (int i, int owner, int local, double value) {
+        cerr << i << " " << owner << " " << local << " " << value << endl;
+    });
+    cerr.flush();
+}
+
 
-bool VerifySpMV (const string &mtxFile, const SparseMatrix &A, const Vector &y) {
+// y is compared with A x (A^T x when transpose is true), x[i] = i + 1
+bool VerifySpMV (const string &mtxFile, const SparseMatrix &A, const Vector &y, bool transpose) {
     bool res = true;
     int rank, size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &size);
-    double *unorderedResult = new double[A.globalNumberOfRows];
-    double *localReorderedResult = new double[A.localNumberOfRows];
-    vector<int> localRows;
-    for (int i = 0; i < A.globalNumberOfRows; i++) {
-        if (rank == A.assign[i]) localRows.push_back(i);
-    }
-    for (int i = 0; i < A.localNumberOfRows; i++) {
-        int idx = lower_bound(localRows.begin(), localRows.end(), A.local2global[i]) - localRows.begin();
-        localReorderedResult[idx] = y.values[i];
-    }
-    int *recvCount = new int[size];
-    memset(recvCount, 0, size * sizeof(int));
-    for (int i = 0; i < A.globalNumberOfRows; i++) recvCount[A.assign[i]]++;
-    int *displs = new int[size+1];
-    displs[0] = 0;
-    for (int i = 0; i < size; i++) displs[i+1] = displs[i] + recvCount[i];
-    MPI_Allgatherv(localReorderedResult, A.localNumberOfRows, MPI_DOUBLE, unorderedResult, recvCount, displs, MPI_DOUBLE, MPI_COMM_WORLD);
-    if (rank != 0) return true;
-    double *result = new double[A.globalNumberOfRows];
-    int *index = new int[size];
-    memset(index, 0, size * sizeof(int));
-    for (int i = 0; i < A.globalNumberOfRows; i++) {
-        int p = A.assign[i];
-        result[i] = unorderedResult[displs[p] + index[p]];
-        index[p]++;
-    }
-    int nRow, nCol, nNnz;
-    vector<Element> elements = GetElementsFromFile(mtxFile, nRow, nCol, nNnz);
-
-    int *ptr = new int[nRow+1];
-    int *idx = new int[nNnz];
-    double *val = new double[nNnz];
-    int p = 0;
-    for (int i = 0; i < nNnz; i++) {
-        int r = elements[i].row;
-        idx[i] = elements[i].col;
-        val[i] = elements[i].val;
-        //if (rank == 0) printf("%d %d %lf\n", r, idx[i], val[i]);
-        while (p <= r) ptr[p++] = i;
+    // the reference is computed on rank 0 from the file, row by row while the blocks of y arrive
+    int nRow = 0, nCol = 0, nNnz = 0;
+    int *ptr = NULL, *idx = NULL;
+    double *val = NULL;
+    if (rank == 0) {
+        vector<Element> elements = GetElementsFromFile(mtxFile, nRow, nCol, nNnz);
+        if (transpose) {
+            for (int i = 0; i < nNnz; i++) swap(elements[i].row, elements[i].col);
+            sort(elements.begin(), elements.end(), RowComparator());
+            swap(nRow, nCol);
+        }
+
+        ptr = new int[nRow+1];
+        idx = new int[nNnz];
+        val = new double[nNnz];
+        int p = 0;
+        for (int i = 0; i < nNnz; i++) {
+            int r = elements[i].row;
+            idx[i] = elements[i].col;
+            val[i] = elements[i].val;
+            //if (rank == 0) printf("%d %d %lf\n", r, idx[i], val[i]);
+            while (p <= r) ptr[p++] = i;
+        }
+        while (p <= nRow) ptr[p++] = nNnz;
     }
-    while (p <= nRow) ptr[p++] = nNnz;
 
-    for (int i = 0; i < nRow; i++) {
+    ForEachResultRow(A, y, [&] (int i, int owner, int local, double result) {
+        if (i >= nRow) return;
         double sum = 0;
         for (int j = ptr[i]; j < ptr[i+1]; j++) {
             // TODO
             sum += val[j] *(idx[j] + 1);
             //sum += val[j] * 1;
         }
-        double relative_error = abs(abs(result[i] - sum) / result[i]);
+        double relative_error = abs(abs(result - sum) / result);
         const double EPS = 1e-8;
         if (relative_error > EPS)  {
-            if (rank == 0) cerr << "Result is wrong at " << i << " expected value: " << sum << " returned value: " << result[i] << " relative error: " << relative_error << " absolute error: " << abs(result[i]-sum) << endl;
+            cerr << "Result is wrong at " << i << " expected value: " << sum << " returned value: " << result << " relative error: " << relative_error << " absolute error: " << abs(result-sum) << endl;
             res = false;
         }
-    }
+    });
+    delete [] ptr;
+    delete [] idx;
+    delete [] val;
     return res;
 }
 
@@ -332,6 +669,16 @@ void DeleteSparseMatrix (SparseMatrix & A) {
 void DeleteVector (Vector & x) {
 }
 
+void DeleteMultiVector (MultiVector & X) {
+    for (int i = 0; i < X.numberOfRecvRequests + X.numberOfSendRequests; i++) MPI_Request_free(&X.requests[i]);
+    delete [] X.requests;
+    delete [] X.values;
+    delete [] X.sendBuffer;
+    X.values = X.sendBuffer = NULL;
+    X.requests = NULL;
+    X.numberOfRecvRequests = X.numberOfSendRequests = 0;
+}
+
 
 void PrintOption () {
     int rank;
@@ -10,14 +10,21 @@ using namespace std;
 
 void PrintHostName ();
 void LoadInput (const string &partFile, SparseMatrix &A, Vector &x);
+void LoadBinaryInput (const string &binaryPartFile, SparseMatrix &A, Vector &x);
+// The blocks and x are placed by first touch with the row split of the portable CSR kernel only
+void CompleteLoadInput (SparseMatrix &A, Vector &x, bool mapped = false);
+bool ExistsFile (const string &file);
 
 void CreateDenseInternalIdx (SparseMatrix &A, Vector &x);
 void CreateZeroVector (Vector &x, int length);
+void CreateLocalVector (const SparseMatrix &A, Vector &y);
+void CreateMultiVector (const SparseMatrix &A, MultiVector &X, int numberOfVectors);
 void PrintResult (SparseMatrix &A, Vector &y);
-bool VerifySpMV (const string &mtxFile, const SparseMatrix &A, const Vector &y);
+bool VerifySpMV (const string &mtxFile, const SparseMatrix &A, const Vector &y, bool transpose = false);
 
 void DeleteSparseMatrix (SparseMatrix & A);
 void DeleteVector (Vector & x);
+void DeleteMultiVector (MultiVector & X);
 
 double GetSynchronizedTime ();
 double GetBarrieredTime ();
@@ -0,0 +1,119 @@
+#include <mpi.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "ownership.h"
+using namespace std;
+
+void CreateOwnershipDirectory (OwnershipDirectory &dir, int globalNumberOfRows, const int *localRowGlobal, int nLocal) {
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    dir.globalNumberOfRows = globalNumberOfRows;
+    dir.rowBegin = NULL;
+    dir.homeOwner = NULL;
+    dir.blockSize = dir.homeBegin = dir.homeLength = 0;
+
+    //--------------------------------------------------------------------------------
+    // Contiguous ranges in rank order
+    //--------------------------------------------------------------------------------
+    int contiguous = 1;
+    for (int i = 1; i < nLocal; i++) {
+        if (localRowGlobal[i] != localRowGlobal[0] + i) contiguous = 0;
+    }
+    int local[3] = {nLocal, nLocal ? localRowGlobal[0] : 0, contiguous};
+    vector<int> all(3 * size);
+    MPI_Allgather(local, 3, MPI_INT, all.data(), 3, MPI_INT, MPI_COMM_WORLD);
+    int begin = 0;
+    for (int r = 0; r < size && contiguous; r++) {
+        if (!all[3*r+2] || (all[3*r] && all[3*r+1] != begin)) contiguous = 0;
+        begin += all[3*r];
+    }
+    if (contiguous && begin == globalNumberOfRows) {
+        dir.rowBegin = new int[size + 1];
+        dir.rowBegin[0] = 0;
+        for (int r = 0; r < size; r++) dir.rowBegin[r+1] = dir.rowBegin[r] + all[3*r];
+        return;
+    }
+
+    //--------------------------------------------------------------------------------
+    // Block distributed owner table
+    //--------------------------------------------------------------------------------
+    dir.blockSize = max(1, (globalNumberOfRows + size - 1) / size);
+    dir.homeBegin = min(globalNumberOfRows, rank * dir.blockSize);
+    dir.homeLength = min(globalNumberOfRows, dir.homeBegin + dir.blockSize) - dir.homeBegin;
+    dir.homeOwner = new int[dir.homeLength];
+    fill(dir.homeOwner, dir.homeOwner + dir.homeLength, -1);
+
+    vector<int> sendCount(size, 0), recvCount(size), sendDispl(size + 1, 0), recvDispl(size + 1, 0);
+    for (int i = 0; i < nLocal; i++) sendCount[localRowGlobal[i] / dir.blockSize]++;
+    MPI_Alltoall(sendCount.data(), 1, MPI_INT, recvCount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0; r < size; r++) {
+        sendDispl[r+1] = sendDispl[r] + sendCount[r];
+        recvDispl[r+1] = recvDispl[r] + recvCount[r];
+    }
+    vector<int> sendRows(nLocal), recvRows(recvDispl[size]);
+    vector<int> cursor(sendDispl.begin(), sendDispl.end() - 1);
+    for (int i = 0; i < nLocal; i++) sendRows[cursor[localRowGlobal[i] / dir.blockSize]++] = localRowGlobal[i];
+    MPI_Alltoallv(sendRows.data(), sendCount.data(), sendDispl.data(), MPI_INT,
+            recvRows.data(), recvCount.data(), recvDispl.data(), MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0; r < size; r++) {
+        for (int i = recvDispl[r]; i < recvDispl[r+1]; i++) dir.homeOwner[recvRows[i] - dir.homeBegin] = r;
+    }
+}
+
+void DeleteOwnershipDirectory (OwnershipDirectory &dir) {
+    delete [] dir.rowBegin;
+    delete [] dir.homeOwner;
+    dir.rowBegin = dir.homeOwner = NULL;
+}
+
+int GetHomeRank (const OwnershipDirectory &dir, int row) {
+    if (!dir.rowBegin) return row / dir.blockSize;
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    return upper_bound(dir.rowBegin, dir.rowBegin + size + 1, row) - dir.rowBegin - 1;
+}
+
+void GetHomeRange (const OwnershipDirectory &dir, int rank, int &begin, int &length) {
+    if (dir.rowBegin) {
+        begin = dir.rowBegin[rank];
+        length = dir.rowBegin[rank+1] - begin;
+        return;
+    }
+    begin = min(dir.globalNumberOfRows, rank * dir.blockSize);
+    length = min(dir.globalNumberOfRows, begin + dir.blockSize) - begin;
+}
+
+void LookupOwners (const OwnershipDirectory &dir, const vector<int> &rows, vector<int> &owners) {
+    int size;
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    owners.resize(rows.size());
+    if (dir.rowBegin) {
+        for (size_t i = 0; i < rows.size(); i++) {
+            owners[i] = upper_bound(dir.rowBegin, dir.rowBegin + size + 1, rows[i]) - dir.rowBegin - 1;
+        }
+        return;
+    }
+
+    // ask the home ranks, the answers come back in the order of the questions
+    vector<int> sendCount(size, 0), recvCount(size), sendDispl(size + 1, 0), recvDispl(size + 1, 0);
+    for (size_t i = 0; i < rows.size(); i++) sendCount[rows[i] / dir.blockSize]++;
+    MPI_Alltoall(sendCount.data(), 1, MPI_INT, recvCount.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    for (int r = 0; r < size; r++) {
+        sendDispl[r+1] = sendDispl[r] + sendCount[r];
+        recvDispl[r+1] = recvDispl[r] + recvCount[r];
+    }
+    vector<int> position(rows.size()), question(rows.size()), answer(recvDispl[size]);
+    vector<int> cursor(sendDispl.begin(), sendDispl.end() - 1);
+    for (size_t i = 0; i < rows.size(); i++) {
+        position[i] = cursor[rows[i] / dir.blockSize]++;
+        question[position[i]] = rows[i];
+    }
+    MPI_Alltoallv(question.data(), sendCount.data(), sendDispl.data(), MPI_INT,
+            answer.data(), recvCount.data(), recvDispl.data(), MPI_INT, MPI_COMM_WORLD);
+    for (size_t i = 0; i < answer.size(); i++) answer[i] = dir.homeOwner[answer[i] - dir.homeBegin];
+    MPI_Alltoallv(answer.data(), recvCount.data(), recvDispl.data(), MPI_INT,
+            question.data(), sendCount.data(), sendDispl.data(), MPI_INT, MPI_COMM_WORLD);
+    for (size_t i = 0; i < rows.size(); i++) owners[i] = question[position[i]];
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <vector>
+using namespace std;
+
+//------------------------------------------
+// Distributed row ownership directory
+//------------------------------------------
+// Replaces the replicated assign[globalNumberOfRows] array.
+// If every rank owns a contiguous range of rows in rank order, only the range
+// boundaries rowBegin[size+1] are kept and lookups are local.
+// Otherwise the owner of row g is kept on its home rank g / blockSize, so that
+// each rank stores at most blockSize owners, and lookups are collective.
+struct OwnershipDirectory {
+    int globalNumberOfRows;
+    int *rowBegin;      // NULL if the rows are not contiguous ranges
+    int blockSize;
+    int homeBegin;
+    int homeLength;
+    int *homeOwner;     // owner of the rows [homeBegin, homeBegin + homeLength)
+};
+
+// Collective. localRowGlobal[0..nLocal) are the global rows owned by this rank.
+void CreateOwnershipDirectory (OwnershipDirectory &dir, int globalNumberOfRows, const int *localRowGlobal, int nLocal);
+void DeleteOwnershipDirectory (OwnershipDirectory &dir);
+// Collective. owners[i] = rank owning the global row rows[i]
+void LookupOwners (const OwnershipDirectory &dir, const vector<int> &rows, vector<int> &owners);
+// The home rank of a row keeps its entry : its owner for contiguous ranges, g / blockSize otherwise.
+// The rows of a home rank are the range [begin, begin + length).
+int GetHomeRank (const OwnershipDirectory &dir, int row);
+void GetHomeRange (const OwnershipDirectory &dir, int rank, int &begin, int &length);
@@ -11,27 +11,48 @@
 #include <cstring>
 #include <cassert>
 #include "util.h"
+#include "binary_part.h"
 #include "patoh.h"
 using namespace std;
 #define PATOH_SEED 19
 
 void GetHypergraphPartitioning (int nPart, int nCell, int nNet, int nConst, int *weights, int *costs, int *xpins, int *pins, int *idx2part);
 void GetSimplePartitioning (int nPart, int nCell, int nNet, int nConst, int *weights, int *costs, int *xpins, int *pins, int *idx2part);
-void CreatePartitionFiles (int nPart, const vector<Element> &elements, int nRow, int nCol, int nNnz, int *idx2part, const string &inputFile, const string &outputDir);
+void CreatePartitionFiles (int nPart, const vector<Element> &elements, int nRow, int nCol, int nNnz, int *idx2part, const string &inputFile, const string &outputDir, bool writeText, bool writeBinary, bool writeCommunication, bool symmetric, bool sendOrder);
+void CreateSendOrder (int nPart, int nCell, const vector<Element> &elements, const int *idx2part, vector<int> &localIndex);
+void WriteBinaryPartFile (const string &path, BinaryPartHeader &header, const void * const *sections);
 void CreateStatFiles (int nPart, const vector<Element> &elements, int nRow, int nCol, int nNnz, int *idx2part, const string &inputFile, const string &outputDir);
 int main(int argc, char *argv[])
 {
-    if (argc != 5) {
-        fprintf(stderr, "Usage: %s <input matrix file> <type of partitioning ('hypergraph' or 'simple')> <number of parts> <output partition directory>\n", argv[0]);
+    if (argc < 5 || argc > 8) {
+        fprintf(stderr, "Usage: %s <input matrix file> <type of partitioning ('hypergraph' or 'simple')> <number of parts> <output partition directory> [format ('text', 'binary' or 'both', default 'both')] [communication plan ('offline' or 'runtime', default 'offline')] [row order ('global' or 'send', default 'global')]\n", argv[0]);
         exit(1);
     }
     string matrixFile = argv[1];
     string partitionType = argv[2];
     int nPart = atoi(argv[3]);
     string outputDir = argv[4];
+    string format = argc >= 6 ? argv[5] : "both";
+    if (format != "text" && format != "binary" && format != "both") {
+        puts("Error: Format is must be 'text', 'binary' or 'both'");
+        exit(0);
+    }
+    // 'runtime' leaves the communication plan out of the part files, spmv builds it with BuildHaloPlan
+    string plan = argc >= 7 ? argv[6] : "offline";
+    if (plan != "offline" && plan != "runtime") {
+        puts("Error: Communication plan is must be 'offline' or 'runtime'");
+        exit(0);
+    }
+    // 'send' numbers the local rows so that the send list of every neighbor is a contiguous range
+    string order = argc >= 8 ? argv[7] : "global";
+    if (order != "global" && order != "send") {
+        puts("Error: Row order is must be 'global' or 'send'");
+        exit(0);
+    }
 
     int nRow, nCol, nNnz;
-    vector<Element> elements = GetElementsFromFile(matrixFile, nRow, nCol, nNnz);
+    bool symmetric;
+    vector<Element> elements = GetElementsFromFile(matrixFile, nRow, nCol, nNnz, &symmetric);
 
     int nPin = nNnz, nCell = nRow, nNet = nCol, nConst = 0;
 
@@ -82,7 +103,17 @@ int main(int argc, char *argv[])
     } else {
         memset(idx2part, 0, nCell * sizeof(int));
     }
-    CreatePartitionFiles(nPart, elements, nRow, nCol, nNnz, idx2part, matrixFile, outputDir);
+    if (symmetric) {
+        // partitioned with the full pattern, only the lower triangle is stored
+        vector<Element> lower;
+        lower.reserve((nNnz + nRow) / 2);
+        for (int i = 0; i < nNnz; i++) {
+            if (elements[i].row >= elements[i].col) lower.push_back(elements[i]);
+        }
+        CreatePartitionFiles(nPart, lower, nRow, nCol, nNnz, idx2part, matrixFile, outputDir, format != "binary", format != "text", plan == "offline", true, order == "send");
+    } else {
+        CreatePartitionFiles(nPart, elements, nRow, nCol, nNnz, idx2part, matrixFile, outputDir, format != "binary", format != "text", plan == "offline", false, order == "send");
+    }
     CreateStatFiles(nPart, elements, nRow, nCol, nNnz, idx2part, matrixFile, outputDir);
 
 //    PaToH_Free();
@@ -118,162 +149,378 @@ void GetSimplePartitioning (int nPart, int nCell, int nNet, int nConst, int *wei
     }
 }
 
-void CreatePartitionFiles (int nPart, const vector<Element> &elements, int nRow, int nCol, int nNnz, int *idx2part, const string &inputFile, const string &outputDir) {
+// Local numbering of the rows of every part for contiguous sends : the rows that are not sent
+// first, then the rows sent to the neighbors. The neighbors are chained (the next one shares the
+// most rows with the previous one only) and the rows of the chain are laid out as
+//   {n0} {n0,n1} {n1} {n1,n2} {n2} ...
+// so the rows sent to a neighbor are consecutive. The rows sent to other sets of neighbors are
+// left at the end (they are packed at run time). Rows keep the global order within a group.
+void CreateSendOrder (int nPart, int nCell, const vector<Element> &elements, const int *idx2part, vector<int> &localIndex) {
+    vector< vector<int> > destination(nCell);
+    for (size_t i = 0; i < elements.size(); i++) {
+        const int rowPart = idx2part[elements[i].row], colPart = idx2part[elements[i].col];
+        if (rowPart != colPart) destination[elements[i].col].push_back(rowPart);
+    }
+    vector< vector<int> > rows(nPart);
+    for (int i = 0; i < nCell; i++) {
+        sort(destination[i].begin(), destination[i].end());
+        destination[i].erase(unique(destination[i].begin(), destination[i].end()), destination[i].end());
+        rows[idx2part[i]].push_back(i);
+    }
+#pragma omp parallel for schedule(dynamic)
+    for (int p = 0; p < nPart; p++) {
+        // rows shared by exactly two neighbors
+        set<int> neighbors;
+        map< pair<int, int>, int > shared;
+        for (size_t k = 0; k < rows[p].size(); k++) {
+            const vector<int> &d = destination[rows[p][k]];
+            neighbors.insert(d.begin(), d.end());
+            if (d.size() == 2) shared[make_pair(d[0], d[1])]++;
+        }
+        // chain : from the lowest neighbor, the next shares the most rows with the last one
+        vector<int> chain;
+        map<int, int> position;
+        set<int> left(neighbors);
+        while (!left.empty()) {
+            int next = *left.begin(), best = 0;
+            if (!chain.empty()) {
+                for (set<int>::iterator n = left.begin(); n != left.end(); ++n) {
+                    const int last = chain.back();
+                    map< pair<int, int>, int >::iterator s = shared.find(make_pair(min(last, *n), max(last, *n)));
+                    if (s != shared.end() && s->second > best) {
+                        best = s->second;
+                        next = *n;
+                    }
+                }
+            }
+            position[next] = chain.size();
+            chain.push_back(next);
+            left.erase(next);
+        }
+        // group : -1 not sent, 2 * position {n}, 2 * position + 1 {n, next of n}, 2 * chain.size() the others
+        vector< pair<int, int> > keys(rows[p].size());
+        for (int k = 0; k < (int) rows[p].size(); k++) {
+            const vector<int> &d = destination[rows[p][k]];
+            int group = 2 * chain.size();
+            if (d.empty()) group = -1;
+            if (d.size() == 1) group = 2 * position[d[0]];
+            if (d.size() == 2) {
+                const int first = min(position[d[0]], position[d[1]]), second = max(position[d[0]], position[d[1]]);
+                if (second == first + 1) group = 2 * first + 1;
+            }
+            keys[k] = make_pair(group, k);
+        }
+        sort(keys.begin(), keys.end());
+        for (int k = 0; k < (int) keys.size(); k++) localIndex[rows[p][keys[k].second]] = k;
+    }
+}
+
+// Nonzeros are bucketed by the owning part of their row in one pass, the communication
+// lists of every part are derived from the buckets and then the parts are written in parallel.
+void CreatePartitionFiles (int nPart, const vector<Element> &elements, int nRow, int nCol, int nNnz, int *idx2part, const string &inputFile, const string &outputDir, bool writeText, bool writeBinary, bool writeCommunication, bool symmetric, bool sendOrder) {
     int nCell = nRow;
     int nNet = nCol;
-    int nPin = nNnz;
-    vector< vector<int> > part2idx(nPart);
+    int nPin = elements.size();
+    const string matrixName = GetBasename(inputFile);
+
+    //----------------------------------------------------------------------
+    // 行の割り当て : 各パートの行は大域番号順に局所番号を振る (sendOrder : CreateSendOrder)
+    //----------------------------------------------------------------------
+    vector<int> partPtr(nPart + 1, 0);
+    vector<int> localIndex(nCell);
     for (int i = 0; i < nCell; i++) {
-        part2idx[idx2part[i]].push_back(i);
+        localIndex[i] = partPtr[idx2part[i] + 1]++;
     }
+    for (int p = 0; p < nPart; p++) partPtr[p+1] += partPtr[p];
+    if (sendOrder) CreateSendOrder(nPart, nCell, elements, idx2part, localIndex);
+    vector<int> part2idx(nCell);
+    for (int i = 0; i < nCell; i++) {
+        part2idx[partPtr[idx2part[i]] + localIndex[i]] = i;
+    }
+
+    //----------------------------------------------------------------------
+    // 非零要素をパート, 局所行の順に並べる (入力の列順を保つ counting sort)
+    //----------------------------------------------------------------------
+    vector<int> rowPtr(nCell + 1, 0);   // indexed by partPtr[part] + localIndex
+    for (int i = 0; i < nPin; i++) {
+        int row = elements[i].row;
+        rowPtr[partPtr[idx2part[row]] + localIndex[row] + 1]++;
+    }
+    for (int i = 0; i < nCell; i++) rowPtr[i+1] += rowPtr[i];
+    vector<Element> bucket(nPin);
+    {
+        vector<int> cursor(rowPtr.begin(), rowPtr.end() - 1);
+        for (int i = 0; i < nPin; i++) {
+            int row = elements[i].row;
+            bucket[cursor[partPtr[idx2part[row]] + localIndex[row]]++] = elements[i];
+        }
+        for (int i = 0; i < nCell; i++) {
+            sort(bucket.begin() + rowPtr[i], bucket.begin() + rowPtr[i+1], ColComparator());
+        }
+    }
+
+    //----------------------------------------------------------------------
+    // 受信リスト : (送信元パート, 送信元の局所番号) の昇順, 送信リストは送信元の局所番号順になる
+    //----------------------------------------------------------------------
+    vector< vector<int> > externalCol(nPart);
+    vector< vector<int> > recvNeighbors(nPart), recvPtr(nPart);
+#pragma omp parallel for schedule(dynamic)
+    for (int p = 0; p < nPart; p++) {
+        vector< pair<int, int> > cols;
+        for (int i = rowPtr[partPtr[p]]; i < rowPtr[partPtr[p+1]]; i++) {
+            int col = bucket[i].col;
+            if (idx2part[col] != p) cols.push_back(make_pair(idx2part[col], localIndex[col]));
+        }
+        sort(cols.begin(), cols.end());
+        cols.erase(unique(cols.begin(), cols.end()), cols.end());
+        for (int i = 0; i < (int) cols.size(); i++) {
+            if (i == 0 || cols[i].first != cols[i-1].first) {
+                recvNeighbors[p].push_back(cols[i].first);
+                recvPtr[p].push_back(i);
+            }
+            externalCol[p].push_back(part2idx[partPtr[cols[i].first] + cols[i].second]);
+        }
+        recvPtr[p].push_back(cols.size());
+    }
+
+    //----------------------------------------------------------------------
+    // 送信リスト : p から dst への送信 = dst の p からの受信
+    //----------------------------------------------------------------------
+    vector< vector<int> > sendNeighbors(nPart), sendLength(nPart), localIndexOfSend(nPart);
+    for (int dst = 0; dst < nPart; dst++) {
+        for (int k = 0; k < (int) recvNeighbors[dst].size(); k++) {
+            int src = recvNeighbors[dst][k];
+            sendNeighbors[src].push_back(dst);
+            sendLength[src].push_back(recvPtr[dst][k+1] - recvPtr[dst][k]);
+            for (int j = recvPtr[dst][k]; j < recvPtr[dst][k+1]; j++) {
+                localIndexOfSend[src].push_back(localIndex[externalCol[dst][j]]);
+            }
+        }
+    }
+
+    //----------------------------------------------------------------------
+    // 書き出し
+    //----------------------------------------------------------------------
+#pragma omp parallel for schedule(dynamic)
     for (int p = 0; p < nPart; p++) {
         string dir = outputDir;
-        string file = GetBasename(inputFile) + "-"
+        string file = matrixName + "-"
             + to_string(static_cast<long long>(nPart)) + "-"
             + to_string(static_cast<long long>(p)) + ".part";
-        //cout << dir + "/" + file << endl;
-        //printf("%s/%s\n", dir.c_str(), file.c_str());
-        ofstream ofs(dir + "/" + file);
-        cout << dir + "/" + file << endl;
-        ofs.precision(18);
-
-        ofs << "#Matrix" << endl;
-        ofs << nRow << " " << nCol << " " << nNnz << " " << nPart << " " << GetBasename(inputFile) << endl;
-        //----------------------------------------------------------------------
-        // 保持する行番号
-        //----------------------------------------------------------------------
-        ofs << "#Partitioning" << endl;
-        for (int i = 0; i < nCell; i++) {
-            if (i) ofs << " ";
-            ofs << idx2part[i];
-        }
-        ofs << endl;
+        const int localNumberOfRows = partPtr[p+1] - partPtr[p];
+        const int externalOffset = localNumberOfRows;
+        const vector<int> &external = externalCol[p];
 
-        //----------------------------------------------------------------------
-        // 前計算 
-        //----------------------------------------------------------------------
+        // global -> local of the columns, internal columns are numbered by localIndex
+        vector<int> local2global(part2idx.begin() + partPtr[p], part2idx.begin() + partPtr[p+1]);
+        local2global.insert(local2global.end(), external.begin(), external.end());
+        vector< pair<int, int> > externalKey(external.size());
+        for (int i = 0; i < (int) external.size(); i++) externalKey[i] = make_pair(idx2part[external[i]], localIndex[external[i]]);
+        auto toLocal = [&](int col) {
+            if (idx2part[col] == p) return localIndex[col];
+            return externalOffset + (int) (lower_bound(externalKey.begin(), externalKey.end(), make_pair(idx2part[col], localIndex[col])) - externalKey.begin());
+        };
 
-        vector< set<int> > sendElements(nCell); // global index of column
-        vector< set<int> > recvElements(nCell); // global index of column
-        for (int i = 0; i < elements.size(); i++) {
-            int row = elements[i].row;
-            int col = elements[i].col;
-            int src = idx2part[col], dst = idx2part[row];
-            if (src == p && dst != p) {
-                sendElements[dst].insert(col);
-            }
-            if (src != p && dst == p) {
-                recvElements[src].insert(col);
+        // local CSR
+        vector<int> internalPtr(localNumberOfRows + 1), externalPtr(localNumberOfRows + 1);
+        vector<int> internalIdx, externalIdx;
+        vector<double> internalVal, externalVal;
+        internalPtr[0] = externalPtr[0] = 0;
+        for (int r = 0; r < localNumberOfRows; r++) {
+            for (int i = rowPtr[partPtr[p] + r]; i < rowPtr[partPtr[p] + r + 1]; i++) {
+                const Element &e = bucket[i];
+                if (idx2part[e.col] == p) {
+                    internalIdx.push_back(localIndex[e.col]);
+                    internalVal.push_back(e.val);
+                } else {
+                    externalIdx.push_back(toLocal(e.col));
+                    externalVal.push_back(e.val);
+                }
             }
-        }
-        vector<int> internalCol = part2idx[p];
-        vector<int> externalCol;
-        {
-            for (int i = 0; i < nCell; i++) {
-                for (auto it = recvElements[i].begin(); it != recvElements[i].end(); it++) {
-                    externalCol.push_back(*it);
+            if (sendOrder) {
+                // the internal columns follow the local numbering
+                vector< pair<int, double> > row;
+                for (int j = internalPtr[r]; j < (int) internalIdx.size(); j++) row.push_back(make_pair(internalIdx[j], internalVal[j]));
+                sort(row.begin(), row.end());
+                for (size_t k = 0; k < row.size(); k++) {
+                    internalIdx[internalPtr[r] + k] = row[k].first;
+                    internalVal[internalPtr[r] + k] = row[k].second;
                 }
             }
+            internalPtr[r+1] = internalIdx.size();
+            externalPtr[r+1] = externalIdx.size();
         }
-        set<int> allCol;
-        for_each(internalCol.begin(), internalCol.end(), [&](int c){ allCol.insert(c); });
-        for_each(externalCol.begin(), externalCol.end(), [&](int c){ allCol.insert(c); });
-
-        // allCol == internalCol + externalCol
-        map<int, int> global2local;
-        const int externalOffset = internalCol.size();
-        sort(internalCol.begin(), internalCol.end());
-        for (int i = 0; i < internalCol.size(); i++) {
-            global2local[internalCol[i]] = i;
-        }
-        for (int i = 0; i < externalCol.size(); i++) {
-            global2local[externalCol[i]] = i + externalOffset;
-        }
-        /*
-        sort(externalCol.begin(), externalCol.end());
-        for (auto it = allCol.begin(); it != allCol.end(); it++) {
-            if (binary_search(internalCol.begin(), internalCol.end(), *it)) {
-                int pos = lower_bound(internalCol.begin(), internalCol.end(), *it) - internalCol.begin();
-                global2local[*it] = pos;
+        const int numInternalNnz = internalIdx.size();
+        const int numExternalNnz = externalIdx.size();
+        vector<int> localIndexOfRecv(external.size());
+        for (int i = 0; i < (int) external.size(); i++) localIndexOfRecv[i] = externalOffset + i;
+        vector<int> recvLength;
+        for (int k = 0; k < (int) recvNeighbors[p].size(); k++) recvLength.push_back(recvPtr[p][k+1] - recvPtr[p][k]);
+
+        if (writeText) {
+            ofstream ofs(dir + "/" + file);
+            ofs.precision(18);
+
+            ofs << "#Matrix" << endl;
+            ofs << nRow << " " << nCol << " " << nNnz << " " << nPart << " " << matrixName << endl;
+            if (symmetric) ofs << "#Symmetric" << endl;
+            //----------------------------------------------------------------------
+            // 保持する部分行列
+            //----------------------------------------------------------------------
+            // row col val
+            if (writeCommunication) {
+                ofs << "#LocalToGlobalTable" << endl;
+                ofs << local2global.size() << endl;
+                for (int i = 0; i < (int) local2global.size(); i++) {
+                    if (i) ofs << " ";
+                    ofs << local2global[i];
+                }
             } else {
-                int pos = lower_bound(externalCol.begin(), externalCol.end(), *it) - externalCol.begin();
-                global2local[*it] = pos + externalOffset;
+                ofs << "#LocalRows" << endl;
+                ofs << localNumberOfRows << endl;
+                for (int i = 0; i < localNumberOfRows; i++) {
+                    if (i) ofs << " ";
+                    ofs << local2global[i];
+                }
             }
-        }*/
+            ofs << endl;
 
-        int nSendNeighbors = 0, nRecvNeighbors = 0;
-        int nSendElements = 0, nRecvElements = 0;
-        for (int i = 0; i < nCell; i++) {
-            if (sendElements[i].size()) nSendNeighbors++;
-            if (recvElements[i].size()) nRecvNeighbors++;
-            nSendElements += sendElements[i].size();
-            nRecvElements += recvElements[i].size();
-        }
-        vector<int> local2global(allCol.size());
-        for (auto it = global2local.begin(); it != global2local.end(); it++) {
-            local2global[it->second] = it->first;
-        }
-        //----------------------------------------------------------------------
-        // 保持する部分行列
-        //----------------------------------------------------------------------
-        // row col val
-        ofs << "#LocalToGlobalTable" << endl;
-        ofs << allCol.size() << endl;
-        for (int i = 0; i < allCol.size(); i++) {
-            if (i) ofs << " ";
-            ofs << local2global[i];
-        }
-        ofs << endl;
+            ofs << "#SubMatrix" << endl;
+            ofs << localNumberOfRows << " " << numInternalNnz << " " << numExternalNnz << endl;
+            for (int r = 0; r < localNumberOfRows; r++) {
+                for (int i = internalPtr[r]; i < internalPtr[r+1]; i++) {
+                    ofs << local2global[r] << " " << local2global[internalIdx[i]] << " " << internalVal[i] << "\n";
+                }
+            }
+            for (int r = 0; r < localNumberOfRows; r++) {
+                for (int i = externalPtr[r]; i < externalPtr[r+1]; i++) {
+                    ofs << local2global[r] << " " << local2global[externalIdx[i]] << " " << externalVal[i] << "\n";
+                }
+            }
 
-        ofs << "#SubMatrix" << endl;
-        sort(elements.begin(), elements.end(), RowComparator());
-        int localNumberOfRows = count(idx2part, idx2part+nCell, p);
-        int numInternalNnz = count_if(elements.begin(), elements.end(), 
-                [&](const Element &e) { return idx2part[e.row] == p && idx2part[e.col] == p; });
-        int numExternalNnz = count_if(elements.begin(), elements.end(), 
-                [&](const Element &e) { return idx2part[e.row] == p && idx2part[e.col] != p; });
-
-        ofs << localNumberOfRows << " " << numInternalNnz << " " << numExternalNnz << endl;
-
-        for_each(elements.begin(), elements.end(), 
-                [&](const Element &e){ if (idx2part[e.row] == p && idx2part[e.col] == p) 
-                ofs << e.row << " " << e.col << " " << e.val << endl; 
-                });
-        for_each(elements.begin(), elements.end(), 
-                [&](const Element &e){ if (idx2part[e.row] == p && idx2part[e.col] != p) 
-                ofs << e.row << " " << e.col << " " << e.val << endl; 
-                });
+            //----------------------------------------------------------------------
+            // 通信 (runtime plan の場合は spmv 側で構築する)
+            //----------------------------------------------------------------------
+            if (writeCommunication) {
+                ofs << "#Communication" << endl;
 
-        //----------------------------------------------------------------------
-        // 通信 
-        //----------------------------------------------------------------------
-        ofs << "#Communication" << endl;
-
-        ofs << "#Send" << endl;
-        ofs << nSendNeighbors << " " << nSendElements << endl;
-        for (int i = 0; i < sendElements.size(); i++) {
-            if (sendElements[i].size()) {
-                ofs << i << " " << sendElements[i].size();
-                for (auto it = sendElements[i].begin(); it != sendElements[i].end(); it++) {
-                    ofs << " " << global2local[*it];
+                ofs << "#Send" << endl;
+                ofs << sendNeighbors[p].size() << " " << localIndexOfSend[p].size() << endl;
+                for (int k = 0, offset = 0; k < (int) sendNeighbors[p].size(); offset += sendLength[p][k++]) {
+                    ofs << sendNeighbors[p][k] << " " << sendLength[p][k];
+                    for (int j = 0; j < sendLength[p][k]; j++) ofs << " " << localIndexOfSend[p][offset + j];
+                    ofs << endl;
+                }
+                ofs << "#Recv" << endl;
+                ofs << recvNeighbors[p].size() << " " << external.size() << endl;
+                for (int k = 0; k < (int) recvNeighbors[p].size(); k++) {
+                    ofs << recvNeighbors[p][k] << " " << recvLength[k];
+                    for (int j = recvPtr[p][k]; j < recvPtr[p][k+1]; j++) ofs << " " << localIndexOfRecv[j];
+                    ofs << endl;
                 }
-                ofs << endl;
             }
+            ofs.close();
+#pragma omp critical
+            cout << dir + "/" + file << endl;
         }
-        ofs << "#Recv" << endl;
-        ofs << nRecvNeighbors << " " << nRecvElements << endl;
-        for (int i = 0; i < recvElements.size(); i++) {
-            if (recvElements[i].size()) {
-                ofs << i << " " << recvElements[i].size();
-                for (auto it = recvElements[i].begin(); it != recvElements[i].end(); it++) {
-                    ofs << " " << global2local[*it];
-                }
-                ofs << endl;
+
+        //----------------------------------------------------------------------
+        // バイナリ形式 
+        //----------------------------------------------------------------------
+        if (writeBinary) {
+            BinaryPartHeader header;
+            memset(&header, 0, sizeof(header));
+            header.globalNumberOfRows = nRow;
+            header.globalNumberOfCols = nCol;
+            header.globalNumberOfNonzeros = nNnz;
+            header.numberOfParts = nPart;
+            header.partId = p;
+            header.hasCommunication = writeCommunication;
+            header.symmetric = symmetric;
+            header.localNumberOfRows = localNumberOfRows;
+            header.numberOfInternalNonzeros = numInternalNnz;
+            header.numberOfExternalNonzeros = numExternalNnz;
+            header.totalNumberOfUsedCols = local2global.size();
+            header.numberOfSendNeighbors = sendNeighbors[p].size();
+            header.totalNumberOfSend = localIndexOfSend[p].size();
+            header.numberOfRecvNeighbors = recvNeighbors[p].size();
+            header.totalNumberOfRecv = external.size();
+            strncpy(header.matrixName, matrixName.c_str(), BINARY_PART_NAME_LENGTH - 1);
+
+            const void *sections[NUMBER_OF_SECTIONS];
+            header.sectionLength[SECTION_LOCAL_TO_GLOBAL] = local2global.size() * sizeof(int);
+            sections[SECTION_LOCAL_TO_GLOBAL] = local2global.data();
+            header.sectionLength[SECTION_INTERNAL_PTR] = internalPtr.size() * sizeof(int);
+            sections[SECTION_INTERNAL_PTR] = internalPtr.data();
+            header.sectionLength[SECTION_INTERNAL_IDX] = internalIdx.size() * sizeof(int);
+            sections[SECTION_INTERNAL_IDX] = internalIdx.data();
+            header.sectionLength[SECTION_INTERNAL_VAL] = internalVal.size() * sizeof(double);
+            sections[SECTION_INTERNAL_VAL] = internalVal.data();
+            header.sectionLength[SECTION_EXTERNAL_PTR] = externalPtr.size() * sizeof(int);
+            sections[SECTION_EXTERNAL_PTR] = externalPtr.data();
+            header.sectionLength[SECTION_EXTERNAL_IDX] = externalIdx.size() * sizeof(int);
+            sections[SECTION_EXTERNAL_IDX] = externalIdx.data();
+            header.sectionLength[SECTION_EXTERNAL_VAL] = externalVal.size() * sizeof(double);
+            sections[SECTION_EXTERNAL_VAL] = externalVal.data();
+            header.sectionLength[SECTION_SEND_NEIGHBORS] = sendNeighbors[p].size() * sizeof(int);
+            sections[SECTION_SEND_NEIGHBORS] = sendNeighbors[p].data();
+            header.sectionLength[SECTION_SEND_LENGTH] = sendLength[p].size() * sizeof(int);
+            sections[SECTION_SEND_LENGTH] = sendLength[p].data();
+            header.sectionLength[SECTION_LOCAL_INDEX_OF_SEND] = localIndexOfSend[p].size() * sizeof(int);
+            sections[SECTION_LOCAL_INDEX_OF_SEND] = localIndexOfSend[p].data();
+            header.sectionLength[SECTION_RECV_NEIGHBORS] = recvNeighbors[p].size() * sizeof(int);
+            sections[SECTION_RECV_NEIGHBORS] = recvNeighbors[p].data();
+            header.sectionLength[SECTION_RECV_LENGTH] = recvLength.size() * sizeof(int);
+            sections[SECTION_RECV_LENGTH] = recvLength.data();
+            header.sectionLength[SECTION_LOCAL_INDEX_OF_RECV] = localIndexOfRecv.size() * sizeof(int);
+            sections[SECTION_LOCAL_INDEX_OF_RECV] = localIndexOfRecv.data();
+
+            // without the plan, only the local rows and the global indices of the external columns are stored
+            vector<int> externalGlobalIdx;
+            if (!writeCommunication) {
+                header.totalNumberOfUsedCols = localNumberOfRows;
+                header.numberOfSendNeighbors = header.totalNumberOfSend = 0;
+                header.numberOfRecvNeighbors = header.totalNumberOfRecv = 0;
+                header.sectionLength[SECTION_LOCAL_TO_GLOBAL] = localNumberOfRows * sizeof(int);
+                externalGlobalIdx.resize(numExternalNnz);
+                for (int i = 0; i < numExternalNnz; i++) externalGlobalIdx[i] = local2global[externalIdx[i]];
+                sections[SECTION_EXTERNAL_IDX] = externalGlobalIdx.data();
+                for (int s = SECTION_SEND_NEIGHBORS; s <= SECTION_LOCAL_INDEX_OF_RECV; s++) header.sectionLength[s] = 0;
             }
+
+            string binaryFile = file.substr(0, file.size() - 5) + ".bpart";
+            WriteBinaryPartFile(dir + "/" + binaryFile, header, sections);
+#pragma omp critical
+            cout << dir + "/" + binaryFile << endl;
         }
-        ofs.close();
     }
 }
+
+// Write header and sections, each section begins at BINARY_PART_ALIGNMENT boundary
+void WriteBinaryPartFile (const string &path, BinaryPartHeader &header, const void * const *sections) {
+    memcpy(header.magic, BINARY_PART_MAGIC, sizeof(header.magic));
+    header.version = BINARY_PART_VERSION;
+    header.headerSize = sizeof(BinaryPartHeader);
+    int64_t offset = AlignBinaryPartOffset(sizeof(BinaryPartHeader));
+    for (int s = 0; s < NUMBER_OF_SECTIONS; s++) {
+        header.sectionOffset[s] = offset;
+        offset = AlignBinaryPartOffset(offset + header.sectionLength[s]);
+    }
+    FILE *fp = fopen(path.c_str(), "wb");
+    if (fp == NULL) {
+        cerr << "Cannot open " << path << endl;
+        exit(1);
+    }
+    const char padding[BINARY_PART_ALIGNMENT] = {};
+    int64_t written = fwrite(&header, 1, sizeof(header), fp);
+    for (int s = 0; s < NUMBER_OF_SECTIONS; s++) {
+        fwrite(padding, 1, header.sectionOffset[s] - written, fp);
+        written = header.sectionOffset[s];
+        if (header.sectionLength[s]) written += fwrite(sections[s], 1, header.sectionLength[s], fp);
+    }
+    fwrite(padding, 1, offset - written, fp);
+    fclose(fp);
+}
 void CreateStatFiles (int nPart, const vector<Element> &elements, int nRow, int nCol, int nNnz, int *idx2part, const string &inputFile, const string &outputDir) {
     string file = GetBasename(inputFile) + "-" + to_string(static_cast<long long>(nPart)) + ".stat";
     ofstream ofs(outputDir + "/" + file);
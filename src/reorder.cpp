@@ -0,0 +1,211 @@
+#include <mpi.h>
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include "reorder.h"
+#include "spmv_kernel.h"
+#include "halo_exchange.h"
+using namespace std;
+
+static const char *reorderNames[] = {"none", "rcm"};
+static const int numberOfReorderMethods = sizeof(reorderNames) / sizeof(reorderNames[0]);
+
+const char* GetReorderMethodName (int method) {
+    return reorderNames[method];
+}
+
+int GetReorderMethod (const string &name) {
+    for (int m = 0; m < numberOfReorderMethods; m++) {
+        if (name == reorderNames[m]) return m;
+    }
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) cerr << "Unknown reordering : " << name << endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+    return REORDER_NONE;
+}
+
+void GetBandwidth (int nRow, const int *ptr, const int *idx, long long &bandwidth, long long &profile) {
+    bandwidth = profile = 0;
+    for (int i = 0; i < nRow; i++) {
+        long long width = 0;
+        for (int j = ptr[i]; j < ptr[i+1]; j++) width = max(width, (long long) abs(i - idx[j]));
+        bandwidth = max(bandwidth, width);
+        profile += width;
+    }
+}
+
+// Pattern of A + A^T without the diagonal, the neighbors of a node are sorted
+static void CreateAdjacency (int n, const int *ptr, const int *idx, vector<int> &adjPtr, vector<int> &adj) {
+    adjPtr.assign(n + 1, 0);
+    for (int i = 0; i < n; i++) {
+        for (int j = ptr[i]; j < ptr[i+1]; j++) {
+            if (idx[j] == i) continue;
+            adjPtr[i+1]++;
+            adjPtr[idx[j]+1]++;
+        }
+    }
+    for (int i = 0; i < n; i++) adjPtr[i+1] += adjPtr[i];
+    adj.resize(adjPtr[n]);
+    vector<int> cursor(adjPtr.begin(), adjPtr.end() - 1);
+    for (int i = 0; i < n; i++) {
+        for (int j = ptr[i]; j < ptr[i+1]; j++) {
+            if (idx[j] == i) continue;
+            adj[cursor[i]++] = idx[j];
+            adj[cursor[idx[j]]++] = i;
+        }
+    }
+    // remove the duplicates (both (i, j) and (j, i) are stored in a general matrix)
+    int p = 0;
+    for (int i = 0; i < n; i++) {
+        const int begin = adjPtr[i], end = adjPtr[i+1];
+        sort(adj.begin() + begin, adj.begin() + end);
+        adjPtr[i] = p;
+        for (int j = begin; j < end; j++) {
+            if (j == begin || adj[j] != adj[j-1]) adj[p++] = adj[j];
+        }
+    }
+    adjPtr[n] = p;
+    adj.resize(p);
+}
+
+// Level structure rooted at root : level[v] = distance from root for the nodes in queue
+// (the component of root), returns the depth. The caller resets level to -1.
+static int CreateLevels (int root, const vector<int> &adjPtr, const vector<int> &adj, vector<int> &level, vector<int> &queue) {
+    queue.clear();
+    queue.push_back(root);
+    level[root] = 0;
+    for (size_t h = 0; h < queue.size(); h++) {
+        const int v = queue[h];
+        for (int j = adjPtr[v]; j < adjPtr[v+1]; j++) {
+            if (level[adj[j]] >= 0) continue;
+            level[adj[j]] = level[v] + 1;
+            queue.push_back(adj[j]);
+        }
+    }
+    return level[queue.back()];
+}
+
+// George-Liu : move to the node of least degree in the last level while the depth grows
+static int FindPseudoPeripheralNode (int start, const vector<int> &adjPtr, const vector<int> &adj, vector<int> &level, vector<int> &queue) {
+    int root = start;
+    int depth = CreateLevels(root, adjPtr, adj, level, queue);
+    for (;;) {
+        int next = -1;
+        for (int h = queue.size() - 1; h >= 0 && level[queue[h]] == depth; h--) {
+            const int v = queue[h];
+            if (next < 0 || adjPtr[v+1] - adjPtr[v] < adjPtr[next+1] - adjPtr[next]) next = v;
+        }
+        for (size_t h = 0; h < queue.size(); h++) level[queue[h]] = -1;
+        const int nextDepth = CreateLevels(next, adjPtr, adj, level, queue);
+        if (nextDepth <= depth) {
+            for (size_t h = 0; h < queue.size(); h++) level[queue[h]] = -1;
+            return root;
+        }
+        root = next;
+        depth = nextDepth;
+    }
+}
+
+void CreateRcmPermutation (int nRow, const int *ptr, const int *idx, vector<int> &perm) {
+    vector<int> adjPtr, adj;
+    CreateAdjacency(nRow, ptr, idx, adjPtr, adj);
+    auto degree = [&adjPtr](int v) { return adjPtr[v+1] - adjPtr[v]; };
+    auto byDegree = [&degree](int a, int b) { return degree(a) < degree(b) || (degree(a) == degree(b) && a < b); };
+    // the components are started from their nodes of least degree
+    vector<int> nodes(nRow);
+    for (int i = 0; i < nRow; i++) nodes[i] = i;
+    stable_sort(nodes.begin(), nodes.end(), byDegree);
+
+    vector<int> level(nRow, -1), queue;
+    vector<char> numbered(nRow, 0);
+    perm.clear();
+    perm.reserve(nRow);
+    for (int s = 0; s < nRow; s++) {
+        if (numbered[nodes[s]]) continue;
+        const int root = FindPseudoPeripheralNode(nodes[s], adjPtr, adj, level, queue);
+        numbered[root] = 1;
+        perm.push_back(root);
+        // Cuthill-McKee : breadth first, the new neighbors of a node in increasing degree
+        for (int h = perm.size() - 1; h < (int) perm.size(); h++) {
+            const int v = perm[h];
+            const int first = perm.size();
+            for (int j = adjPtr[v]; j < adjPtr[v+1]; j++) {
+                if (numbered[adj[j]]) continue;
+                numbered[adj[j]] = 1;
+                perm.push_back(adj[j]);
+            }
+            sort(perm.begin() + first, perm.end(), byDegree);
+        }
+    }
+    reverse(perm.begin(), perm.end());
+}
+
+// Rows of the block in the new order, the columns are renumbered by inverse (kept when NULL)
+// and sorted in each row
+static void PermuteBlock (int n, int *ptr, int *idx, double *val, const vector<int> &perm, const int *inverse) {
+    vector<int> oldPtr(ptr, ptr + n + 1), oldIdx(idx, idx + ptr[n]);
+    vector<double> oldVal(val, val + ptr[n]);
+    for (int i = 0; i < n; i++) ptr[i+1] = ptr[i] + (oldPtr[perm[i]+1] - oldPtr[perm[i]]);
+#pragma omp parallel
+    {
+        vector<pair<int, double> > row;
+#pragma omp for schedule(static)
+        for (int i = 0; i < n; i++) {
+            row.clear();
+            for (int j = oldPtr[perm[i]]; j < oldPtr[perm[i]+1]; j++) {
+                row.push_back(make_pair(inverse ? inverse[oldIdx[j]] : oldIdx[j], oldVal[j]));
+            }
+            if (inverse) sort(row.begin(), row.end());
+            for (size_t k = 0; k < row.size(); k++) {
+                idx[ptr[i] + k] = row[k].first;
+                val[ptr[i] + k] = row[k].second;
+            }
+        }
+    }
+}
+
+void PermuteLocalRows (SparseMatrix &A, Vector &x, const vector<int> &perm) {
+#ifdef GPU
+    std::cerr << "Reordering is not supported on GPU" << std::endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+#endif
+    const int n = A.localNumberOfRows;
+    vector<int> inverse(n);
+    for (int i = 0; i < n; i++) inverse[perm[i]] = i;
+    PermuteBlock(n, A.internalPtr, A.internalIdx, A.internalVal, perm, inverse.data());
+    PermuteBlock(n, A.externalPtr, A.externalIdx, A.externalVal, perm, NULL);
+    for (int i = 0; i < A.totalNumberOfSend; i++) A.localIndexOfSend[i] = inverse[A.localIndexOfSend[i]];
+    UpdateHaloSendIndices(A);
+
+    vector<int> rowGlobal(A.local2global, A.local2global + n);
+    vector<double> rowValue(x.values, x.values + n);
+    for (int i = 0; i < n; i++) {
+        A.local2global[i] = rowGlobal[perm[i]];
+        x.values[i] = rowValue[perm[i]];
+    }
+    DeleteGlobalToLocalTable(A.global2local);
+    CreateGlobalToLocalTable(A.global2local, A.local2global, A.totalNumberOfUsedCols);
+
+    // the scatter windows depend on the internal columns
+    if (A.symmetric) {
+        delete [] A.scatterRowBegin;
+        delete [] A.scatterWindowBegin;
+        delete [] A.scatterWindowEnd;
+        delete [] A.scatterOffset;
+        delete [] A.scatterBuffer;
+        delete [] A.transposeBuffer;
+        CreateScatterSchedule(A);
+    }
+}
+
+void ReorderLocalRows (SparseMatrix &A, Vector &x, int method, long long bandwidth[2], long long profile[2]) {
+    const int n = A.localNumberOfRows;
+    GetBandwidth(n, A.internalPtr, A.internalIdx, bandwidth[0], profile[0]);
+    if (method == REORDER_RCM) {
+        vector<int> perm;
+        CreateRcmPermutation(n, A.internalPtr, A.internalIdx, perm);
+        PermuteLocalRows(A, x, perm);
+    }
+    GetBandwidth(n, A.internalPtr, A.internalIdx, bandwidth[1], profile[1]);
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "sparse_matrix.h"
+#include "vector.h"
+using namespace std;
+
+//------------------------------------------
+// Reordering of the local rows
+//------------------------------------------
+// The local rows (which are also the internal columns) are renumbered by a bandwidth
+// reducing permutation of the internal block. The external columns, the recv lists and
+// the rows of the other ranks do not change, local2global keeps x and the verification
+// consistent.
+#define REORDER_NONE    0
+#define REORDER_RCM     1
+
+int GetReorderMethod (const string &name);
+const char* GetReorderMethodName (int method);
+// bandwidth = max |i - j|, profile = sum over the rows of max |i - j| of the row
+void GetBandwidth (int nRow, const int *ptr, const int *idx, long long &bandwidth, long long &profile);
+// Reverse Cuthill-McKee ordering of the symmetrized pattern of the block (columns < nRow),
+// perm[new] = old. Every connected component starts from a pseudo-peripheral node.
+void CreateRcmPermutation (int nRow, const int *ptr, const int *idx, vector<int> &perm);
+// The local row perm[i] becomes the local row i : the internal/external blocks, the
+// internal columns, the send lists, local2global, global2local and the local part of x
+void PermuteLocalRows (SparseMatrix &A, Vector &x, const vector<int> &perm);
+// Reorders A and x by the method, (before, after) bandwidth and profile of the internal block
+void ReorderLocalRows (SparseMatrix &A, Vector &x, int method, long long bandwidth[2], long long profile[2]);
@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <vector>
+#include "sell.h"
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+using namespace std;
+
+void CreateSellMatrix (SellMatrix &S, int nRow, const int *ptr, const int *idx, const double *val, int sigma) {
+    const int C = SELL_CHUNK_HEIGHT;
+    sigma = max(C, sigma / C * C);
+    S.numberOfRows = nRow;
+    S.numberOfChunks = (nRow + C - 1) / C;
+    S.sigma = sigma;
+    S.numberOfNonzeros = ptr[nRow];
+
+    //------------------------------------------
+    // Sort the rows by length (descending) in each window of sigma rows
+    //------------------------------------------
+    S.perm = new int[nRow];
+    for (int i = 0; i < nRow; i++) S.perm[i] = i;
+    for (int begin = 0; begin < nRow; begin += sigma) {
+        int end = min(nRow, begin + sigma);
+        stable_sort(S.perm + begin, S.perm + end, [ptr](int a, int b) {
+            return ptr[a+1] - ptr[a] > ptr[b+1] - ptr[b];
+        });
+    }
+
+    //------------------------------------------
+    // Chunks
+    //------------------------------------------
+    S.chunkPtr = new int[S.numberOfChunks + 1];
+    S.chunkPtr[0] = 0;
+    for (int c = 0; c < S.numberOfChunks; c++) {
+        int width = 0;
+        for (int s = c * C; s < min(nRow, (c + 1) * C); s++) width = max(width, ptr[S.perm[s]+1] - ptr[S.perm[s]]);
+        S.chunkPtr[c+1] = S.chunkPtr[c] + width * C;
+    }
+    S.numberOfStoredElements = S.chunkPtr[S.numberOfChunks];
+    S.idx = new int[S.numberOfStoredElements];
+    S.val = new double[S.numberOfStoredElements];
+#pragma omp parallel for schedule(static)
+    for (int c = 0; c < S.numberOfChunks; c++) {
+        const int width = (S.chunkPtr[c+1] - S.chunkPtr[c]) / C;
+        for (int lane = 0; lane < C; lane++) {
+            const int s = c * C + lane;
+            const int length = s < nRow ? ptr[S.perm[s]+1] - ptr[S.perm[s]] : 0;
+            const int offset = s < nRow ? ptr[S.perm[s]] : 0;
+            for (int j = 0; j < width; j++) {
+                const int k = S.chunkPtr[c] + j * C + lane;
+                S.idx[k] = j < length ? idx[offset + j] : 0;
+                S.val[k] = j < length ? val[offset + j] : 0;
+            }
+        }
+    }
+}
+
+void DeleteSellMatrix (SellMatrix &S) {
+    delete [] S.chunkPtr;
+    delete [] S.perm;
+    delete [] S.idx;
+    delete [] S.val;
+    S.chunkPtr = S.perm = S.idx = NULL;
+    S.val = NULL;
+}
+
+// The lanes of a chunk are written back to their rows, the last chunk may be partial
+static inline void StoreChunk (const SellMatrix &S, int c, const double *sum, double *y, bool accumulate) {
+    const int C = SELL_CHUNK_HEIGHT;
+    const int n = min(C, S.numberOfRows - c * C);
+    const int *perm = S.perm + c * C;
+    if (accumulate) {
+        for (int lane = 0; lane < n; lane++) y[perm[lane]] += sum[lane];
+    } else {
+        for (int lane = 0; lane < n; lane++) y[perm[lane]] = sum[lane];
+    }
+}
+
+void SellMV (const SellMatrix &S, const double *x, double *y, bool accumulate) {
+    const int C = SELL_CHUNK_HEIGHT;
+#pragma omp parallel for schedule(runtime)
+    for (int c = 0; c < S.numberOfChunks; c++) {
+        const int *idx = S.idx + S.chunkPtr[c];
+        const double *val = S.val + S.chunkPtr[c];
+        const int width = (S.chunkPtr[c+1] - S.chunkPtr[c]) / C;
+#if defined(__AVX512F__)
+        __m512d sum = _mm512_setzero_pd();
+        for (int j = 0; j < width; j++) {
+            __m256i vi = _mm256_loadu_si256((const __m256i *) (idx + j * C));
+            __m512d vx = _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, vi, x, 8);
+            sum = _mm512_fmadd_pd(_mm512_loadu_pd(val + j * C), vx, sum);
+        }
+        double result[C];
+        _mm512_storeu_pd(result, sum);
+#elif defined(__AVX2__)
+        __m256d sum = _mm256_setzero_pd();
+        for (int j = 0; j < width; j++) {
+            __m128i vi = _mm_loadu_si128((const __m128i *) (idx + j * C));
+            __m256d vx = _mm256_i32gather_pd(x, vi, 8);
+#ifdef __FMA__
+            sum = _mm256_fmadd_pd(_mm256_loadu_pd(val + j * C), vx, sum);
+#else
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(val + j * C), vx));
+#endif
+        }
+        double result[C];
+        _mm256_storeu_pd(result, sum);
+#else
+        double result[C] = {};
+        for (int j = 0; j < width; j++) {
+#pragma omp simd
+            for (int lane = 0; lane < C; lane++) result[lane] += val[j * C + lane] * x[idx[j * C + lane]];
+        }
+#endif
+        StoreChunk(S, c, result, y, accumulate);
+    }
+}
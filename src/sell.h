@@ -0,0 +1,32 @@
+#pragma once
+
+//------------------------------------------
+// SELL-C-sigma (sliced ELLPACK)
+//------------------------------------------
+// Rows are sorted by length in windows of sigma rows and packed into chunks of
+// SELL_CHUNK_HEIGHT rows. A chunk is stored column major with the width of its longest
+// row, shorter rows are padded with (column 0, value 0).
+// Slot s (= chunk * SELL_CHUNK_HEIGHT + lane) holds the local row perm[s].
+#if defined(__AVX512F__)
+#define SELL_CHUNK_HEIGHT   8
+#else
+#define SELL_CHUNK_HEIGHT   4
+#endif
+#define SELL_DEFAULT_SIGMA  128
+
+struct SellMatrix {
+    int numberOfRows;
+    int numberOfChunks;
+    int sigma;
+    long long numberOfNonzeros;
+    long long numberOfStoredElements;   // including the padding
+    int *chunkPtr;                      // [numberOfChunks + 1] offset of the chunk in idx/val
+    int *perm;                          // [numberOfRows]
+    int *idx;
+    double *val;
+};
+
+void CreateSellMatrix (SellMatrix &S, int nRow, const int *ptr, const int *idx, const double *val, int sigma);
+void DeleteSellMatrix (SellMatrix &S);
+// y = S x (accumulate == false) or y += S x (accumulate == true)
+void SellMV (const SellMatrix &S, const double *x, double *y, bool accumulate);
@@ -1,7 +1,36 @@
 #pragma once
-#include <map>
+#include "index_table.h"
+#include "ownership.h"
+#include "sell.h"
+#include "merge_path.h"
+#include "dcsr.h"
+#include "bcsr.h"
+
+// The MKL builds run the CSR blocks through inspector-executor handles
+#if (defined(CPU) || defined(MIC)) && !defined(MY_CSRMV) && !defined(NO_MKL_INSPECTOR_EXECUTOR)
+#define MKL_INSPECTOR_EXECUTOR
+#include <mkl.h>
+#endif
+#define MKL_DEFAULT_EXPECTED_CALLS  1000
+
+// Storage format of the internal/external blocks (see CreateStorageFormat)
+#define FORMAT_CSR      0
+#define FORMAT_SELL     1
+#define FORMAT_MERGE    2
+#define FORMAT_BCSR     3
+#define FORMAT_DCSR     4
+#define NUMBER_OF_FORMATS   5
+
+// OpenMP schedule of the row loops of the kernels
+#define SCHEDULE_STATIC     0
+#define SCHEDULE_DYNAMIC    1
+#define NUMBER_OF_SCHEDULES 2
+#define SCHEDULE_DYNAMIC_CHUNK  64
+
+struct HaloExchange;
+
 struct SparseMatrix {
-    int *assign;
+    OwnershipDirectory rowOwner;
     int globalNumberOfRows;
     int globalNumberOfNonzeros;
     int localNumberOfRows;
@@ -16,9 +45,22 @@ struct SparseMatrix {
     int *externalIdx;
     double *externalVal;
 
+    int internalFormat;
+    int externalFormat;
+    int internalSchedule;
+    int externalSchedule;
+    SellMatrix internalSell;
+    SellMatrix externalSell;
+    MergePathSchedule internalMerge;
+    MergePathSchedule externalMerge;
+    DcsrMatrix internalDcsr;
+    DcsrMatrix externalDcsr;
+    BcsrMatrix internalBcsr;
+    BcsrMatrix externalBcsr;
+
     int totalNumberOfUsedCols;
     int *local2global;
-    std::map<int, int> global2local;
+    GlobalToLocalTable global2local;
 
     int numberOfSendNeighbors;
     int numberOfRecvNeighbors;    
@@ -32,6 +74,25 @@ struct SparseMatrix {
     int *localIndexOfSend;
     int *localIndexOfRecv;
     double *sendBuffer;
+    HaloExchange *halo;             // persistent requests (see halo_exchange.h)
+
+    //==============================
+    // Symmetric storage and transpose SpMV
+    //==============================
+    // Only the lower triangle is stored, the transpose of the external block is sent
+    // back to the owners of the external rows (ReverseHaloExchange).
+    // The same buffers are used by the transpose SpMV of a general matrix.
+    bool symmetric;
+    double *transposeBuffer;        // [totalNumberOfRecv]
+    // The internal block is split into row blocks, one per thread. The transpose
+    // contributions of a thread outside of its rows go to its own window of rows
+    // [scatterWindowBegin[t], scatterWindowEnd[t]) at scatterBuffer + scatterOffset[t].
+    int numberOfScatterThreads;
+    int *scatterRowBegin;           // [numberOfScatterThreads + 1]
+    int *scatterWindowBegin;
+    int *scatterWindowEnd;
+    long long *scatterOffset;
+    double *scatterBuffer;
 
     // for cache
     int *denseInternalIdx;
@@ -41,6 +102,12 @@ struct SparseMatrix {
 #endif
 
 
+#ifdef MKL_INSPECTOR_EXECUTOR
+    // analyzed by mkl_sparse_optimize, NULL when the block is not run by MKL
+    sparse_matrix_t internalHandle;
+    sparse_matrix_t externalHandle;
+#endif
+
 #ifdef GPU
     int *cuda_internalPtr;
     int *cuda_internalIdx;
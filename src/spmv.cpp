@@ -7,35 +7,17 @@
 #include "spmv_kernel.h"
 #include "mpi_util.h"
 #include "timing.h"
+#include "halo_exchange.h"
 using namespace std;
 int SpMV_overlap (const SparseMatrix &A, Vector &x, Vector &y) {
     //==============================
     // Packing
     //==============================
-    double *xv = x.values;
-    double *sendBuffer = A.sendBuffer;
-#pragma omp parallel for
-//#pragma ivdep
-    for (int i = 0; i < A.totalNumberOfSend; i++) sendBuffer[i] = xv[A.localIndexOfSend[i]];
+    PackHaloSend(A, x.values);
     //==============================
     // Begin Asynchronouse Communication
     //==============================
-    const int MPI_MY_TAG = 141421356;
-    MPI_Request *recvRequests = new MPI_Request[A.numberOfRecvNeighbors];
-    MPI_Request *sendRequests = new MPI_Request[A.numberOfSendNeighbors];
-    double *x_external = (double *) xv + A.localNumberOfRows;
-    for (int i = 0; i < A.numberOfRecvNeighbors; i++) {
-        int nRecv = A.recvLength[i];
-        int src = A.recvNeighbors[i];
-        MPI_Irecv(x_external, nRecv, MPI_DOUBLE, src, MPI_MY_TAG, MPI_COMM_WORLD, &recvRequests[i]);
-        x_external += nRecv;
-    }
-    for (int i = 0; i < A.numberOfSendNeighbors; i++) {
-        int nSend = A.sendLength[i];
-        int dst = A.sendNeighbors[i];
-        MPI_Isend(sendBuffer, nSend, MPI_DOUBLE, dst, MPI_MY_TAG, MPI_COMM_WORLD, &sendRequests[i]);
-        sendBuffer += nSend;
-    }
+    StartHaloExchange(A, x);
     //==============================
     // Compute Internal
     //==============================
@@ -49,13 +31,7 @@ int SpMV_overlap (const SparseMatrix &A, Vector &x, Vector &y) {
     //==============================
     // Wait Asynchronous Communication
     //==============================
-    MPI_Status *recvStatuses = new MPI_Status[A.numberOfRecvNeighbors];
-    if (A.numberOfRecvNeighbors) {
-        if (MPI_Waitall(A.numberOfRecvNeighbors, recvRequests, recvStatuses)) {
-            std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
-            std::exit(-1);
-        }
-    }
+    WaitHaloRecv(A);
     //==============================
     // Compute External
     //==============================
@@ -66,17 +42,8 @@ int SpMV_overlap (const SparseMatrix &A, Vector &x, Vector &y) {
     //==============================
     // Wait Asynchronous Communication
     //==============================
-    MPI_Status *sendStatuses = new MPI_Status[A.numberOfSendNeighbors];
-    if (A.numberOfSendNeighbors) {
-        if (MPI_Waitall(A.numberOfSendNeighbors, sendRequests, sendStatuses)) {
-            std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
-            std::exit(-1);
-        }
-    }
-    delete [] recvRequests;
-    delete [] sendRequests;
-    delete [] recvStatuses;
-    delete [] sendStatuses;
+    WaitHaloSend(A);
+    if (A.symmetric) ReverseHaloExchange(A, A.transposeBuffer, y);
     return 0;
 
 }
@@ -86,54 +53,19 @@ int SpMV_no_overlap (const SparseMatrix &A, Vector &x, Vector &y) {
     //==============================
     // Packing
     //==============================
-    double *xv = x.values;
-    double *sendBuffer = A.sendBuffer;
-#pragma omp parallel for
-//#pragma ivdep
-    for (int i = 0; i < A.totalNumberOfSend; i++) sendBuffer[i] = xv[A.localIndexOfSend[i]];
+    PackHaloSend(A, x.values);
     //==============================
     // Begin Asynchronouse Communication
     //==============================
-    const int MPI_MY_TAG = 141421356;
-    MPI_Request *recvRequests = new MPI_Request[A.numberOfRecvNeighbors];
-    MPI_Request *sendRequests = new MPI_Request[A.numberOfSendNeighbors];
-    double *x_external = (double *) xv + A.localNumberOfRows;
-    for (int i = 0; i < A.numberOfRecvNeighbors; i++) {
-        int nRecv = A.recvLength[i];
-        int src = A.recvNeighbors[i];
-        MPI_Irecv(x_external, nRecv, MPI_DOUBLE, src, MPI_MY_TAG, MPI_COMM_WORLD, &recvRequests[i]);
-        x_external += nRecv;
-    }
-    for (int i = 0; i < A.numberOfSendNeighbors; i++) {
-        int nSend = A.sendLength[i];
-        int dst = A.sendNeighbors[i];
-        MPI_Isend(sendBuffer, nSend, MPI_DOUBLE, dst, MPI_MY_TAG, MPI_COMM_WORLD, &sendRequests[i]);
-        sendBuffer += nSend;
-    }
+    StartHaloExchange(A, x);
     //==============================
     // Wait Asynchronous Communication
     //==============================
-    MPI_Status *recvStatuses = new MPI_Status[A.numberOfRecvNeighbors];
-    if (A.numberOfRecvNeighbors) {
-        if (MPI_Waitall(A.numberOfRecvNeighbors, recvRequests, recvStatuses)) {
-            std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
-            std::exit(-1);
-        }
-    }
+    WaitHaloRecv(A);
     //==============================
     // Wait Asynchronous Communication
     //==============================
-    MPI_Status *sendStatuses = new MPI_Status[A.numberOfSendNeighbors];
-    if (A.numberOfSendNeighbors) {
-        if (MPI_Waitall(A.numberOfSendNeighbors, sendRequests, sendStatuses)) {
-            std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
-            std::exit(-1);
-        }
-    }
-    delete [] recvRequests;
-    delete [] sendRequests;
-    delete [] recvStatuses;
-    delete [] sendStatuses;
+    WaitHaloSend(A);
     //==============================
     // Compute Internal
     //==============================
@@ -150,13 +82,43 @@ int SpMV_no_overlap (const SparseMatrix &A, Vector &x, Vector &y) {
     {
         SpMVExternal(A, x, y);
     }
+    if (A.symmetric) ReverseHaloExchange(A, A.transposeBuffer, y);
     return 0;
 }
 
 
-int SpMV_measurement_once (const SparseMatrix &A, Vector &x, Vector &y) {
+// Time of the halo exchange (and of the reverse one for the symmetric storage)
+static double MeasureCommunication (const SparseMatrix &A, Vector &x, Vector &y) {
+    double begin = GetSynchronizedTime();
+    int nLoop = 1;
+    while (GetSynchronizedTime() - begin < THRESHOLD_SECOND) {
+        for (int l = 0; l < nLoop; l++) {
+            StartHaloExchange(A, x);
+            WaitHaloRecv(A);
+            WaitHaloSend(A);
+            if (A.symmetric) ReverseHaloExchange(A, A.transposeBuffer, y);
+        }
+        nLoop *= 2;
+    }
+
+    double elapsedTime = -GetBarrieredTime();
+    for (int l = 0; l < nLoop ; l++) {
+        StartHaloExchange(A, x);
+        WaitHaloRecv(A);
+        WaitHaloSend(A);
+        if (A.symmetric) ReverseHaloExchange(A, A.transposeBuffer, y);
+    }
+
+    elapsedTime += GetBarrieredTime();
+    return elapsedTime / nLoop;
+}
+
+
+// buffered : A with a PACK_BUFFER exchange, A itself when A packs into sendBuffer. The datatype
+// sends are compared with the exchange of the packed sendBuffer (Packing + BufferCommunication
+// against TotalCommunication).
+int SpMV_measurement_once (const SparseMatrix &A, const SparseMatrix &buffered, Vector &x, Vector &y) {
     double* const xv = x.values;
-    double *sendBuffer = A.sendBuffer;
 
     //==============================
     // Packing
@@ -166,16 +128,12 @@ int SpMV_measurement_once (const SparseMatrix &A, Vector &x, Vector &y) {
     begin = GetSynchronizedTime();
     nLoop = 1;
     while (GetSynchronizedTime() - begin < THRESHOLD_SECOND) {
-        for (int l = 0; l < nLoop; l++) {
-#pragma omp parallel for
-            for (int i = 0; i < A.totalNumberOfSend; i++) sendBuffer[i] = xv[A.localIndexOfSend[i]];
-        }
+        for (int l = 0; l < nLoop; l++) PackHaloSend(buffered, xv);
         nLoop *= 2;
     }
     elapsedTime = -GetBarrieredTime();
     for (int l = 0; l < nLoop; l++) {
-#pragma omp parallel for
-        for (int i = 0; i < A.totalNumberOfSend; i++) sendBuffer[i] = xv[A.localIndexOfSend[i]];
+        PackHaloSend(buffered, xv);
     }
     elapsedTime += GetBarrieredTime();
     timingTemp[TIMING_PACKING] = elapsedTime / nLoop;
@@ -183,92 +141,11 @@ int SpMV_measurement_once (const SparseMatrix &A, Vector &x, Vector &y) {
     //==============================
     // Begin asynchronouse communication
     //==============================
-
-    begin = GetSynchronizedTime();
-    nLoop = 1;
-    while (GetSynchronizedTime() - begin < THRESHOLD_SECOND) {
-        for (int l = 0; l < nLoop; l++) {
-            const int MPI_MY_TAG = 141421356 + l;
-            MPI_Request *recvRequests = new MPI_Request[A.numberOfRecvNeighbors];
-            MPI_Request *sendRequests = new MPI_Request[A.numberOfSendNeighbors];
-            double *x_external = (double *) xv + A.localNumberOfRows;
-            sendBuffer = A.sendBuffer;
-            for (int i = 0; i < A.numberOfRecvNeighbors; i++) {
-                int nRecv = A.recvLength[i];
-                int src = A.recvNeighbors[i];
-                MPI_Irecv(x_external, nRecv, MPI_DOUBLE, src, MPI_MY_TAG, MPI_COMM_WORLD, &recvRequests[i]);
-                x_external += nRecv;
-            }
-            for (int i = 0; i < A.numberOfSendNeighbors; i++) {
-                int nSend = A.sendLength[i];
-                int dst = A.sendNeighbors[i];
-                MPI_Isend(sendBuffer, nSend, MPI_DOUBLE, dst, MPI_MY_TAG, MPI_COMM_WORLD, &sendRequests[i]);
-                sendBuffer += nSend;
-            }
-            MPI_Status *recvStatuses = new MPI_Status[A.numberOfRecvNeighbors];
-            if (A.numberOfRecvNeighbors) {
-                if (MPI_Waitall(A.numberOfRecvNeighbors, recvRequests, recvStatuses)) {
-                    std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
-                    std::exit(-1);
-                }
-            }
-            MPI_Status *sendStatuses = new MPI_Status[A.numberOfSendNeighbors];
-            if (A.numberOfSendNeighbors) {
-                if (MPI_Waitall(A.numberOfSendNeighbors, sendRequests, sendStatuses)) {
-                    std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
-                    std::exit(-1);
-                }
-            }
-            delete [] recvRequests;
-            delete [] sendRequests;
-            delete [] recvStatuses;
-            delete [] sendStatuses;
-        }
-        nLoop *= 2;
+    timingTemp[TIMING_TOTAL_COMMUNICATION] = MeasureCommunication(A, x, y);
+    if (buffered.halo != A.halo) {
+        timingTemp[TIMING_BUFFER_COMMUNICATION] = MeasureCommunication(buffered, x, y);
     }
 
-    elapsedTime = -GetBarrieredTime();
-    for (int l = 0; l < nLoop ; l++) {
-        const int MPI_MY_TAG = 141421356 + l;
-        MPI_Request *recvRequests = new MPI_Request[A.numberOfRecvNeighbors];
-        MPI_Request *sendRequests = new MPI_Request[A.numberOfSendNeighbors];
-        double *x_external = (double *) xv + A.localNumberOfRows;
-        sendBuffer = A.sendBuffer;
-        for (int i = 0; i < A.numberOfRecvNeighbors; i++) {
-            int nRecv = A.recvLength[i];
-            int src = A.recvNeighbors[i];
-            MPI_Irecv(x_external, nRecv, MPI_DOUBLE, src, MPI_MY_TAG, MPI_COMM_WORLD, &recvRequests[i]);
-            x_external += nRecv;
-        }
-        for (int i = 0; i < A.numberOfSendNeighbors; i++) {
-            int nSend = A.sendLength[i];
-            int dst = A.sendNeighbors[i];
-            MPI_Isend(sendBuffer, nSend, MPI_DOUBLE, dst, MPI_MY_TAG, MPI_COMM_WORLD, &sendRequests[i]);
-            sendBuffer += nSend;
-        }
-        MPI_Status *recvStatuses = new MPI_Status[A.numberOfRecvNeighbors];
-        if (A.numberOfRecvNeighbors) {
-            if (MPI_Waitall(A.numberOfRecvNeighbors, recvRequests, recvStatuses)) {
-                std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
-                std::exit(-1);
-            }
-        }
-        MPI_Status *sendStatuses = new MPI_Status[A.numberOfSendNeighbors];
-        if (A.numberOfSendNeighbors) {
-            if (MPI_Waitall(A.numberOfSendNeighbors, sendRequests, sendStatuses)) {
-                std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
-                std::exit(-1);
-            }
-        }
-        delete [] recvRequests;
-        delete [] sendRequests;
-        delete [] recvStatuses;
-        delete [] sendStatuses;
-    }
-
-    elapsedTime += GetBarrieredTime();
-    timingTemp[TIMING_TOTAL_COMMUNICATION] = elapsedTime / nLoop;
-
     //==============================
     // Compute Internal
     //==============================
@@ -311,3 +188,80 @@ int SpMV_measurement_once (const SparseMatrix &A, Vector &x, Vector &y) {
     timingTemp[TIMING_EXTERNAL_COMPUTATION] = elapsedTime / nLoop;
     return 0;
 }
+
+
+// Send the contributions to the external rows back to their owners and accumulate the
+// received ones into y (the reverse of the halo exchange). sendBuffer is used for receiving,
+// so the forward exchange must have been completed.
+void ReverseHaloExchange (const SparseMatrix &A, const double *contribution, Vector &y) {
+    StartReverseHaloExchange(A, contribution);
+    WaitHaloRecv(A);
+    // a row may be sent to several neighbors, so the neighbors are accumulated one by one
+    double *yv = y.values;
+    for (int k = 0, offset = 0; k < A.numberOfSendNeighbors; offset += A.sendLength[k++]) {
+        const int *index = A.localIndexOfSend + offset;
+        const double *received = A.sendBuffer + offset;
+#pragma omp parallel for
+        for (int i = 0; i < A.sendLength[k]; i++) yv[index[i]] += received[i];
+    }
+    WaitHaloSend(A);
+}
+
+
+// Y = A X for k vectors. The k values of a row travel together, so there is one message
+// per neighbor as in SpMV, k times longer (the persistent requests created with X).
+// Symmetric storage is not supported.
+int SpMM (const SparseMatrix &A, MultiVector &X, MultiVector &Y) {
+    //==============================
+    // Packing
+    //==============================
+    const int k = X.numberOfVectors;
+    double *xv = X.values;
+    double *sendBuffer = X.sendBuffer;
+#pragma omp parallel for
+    for (int i = 0; i < A.totalNumberOfSend; i++) {
+        const double *src = xv + (long long) A.localIndexOfSend[i] * k;
+        for (int v = 0; v < k; v++) sendBuffer[(long long) i * k + v] = src[v];
+    }
+    //==============================
+    // Begin Asynchronouse Communication (persistent requests of X)
+    //==============================
+    const int nRequest = X.numberOfRecvRequests + X.numberOfSendRequests;
+    if (nRequest) MPI_Startall(nRequest, X.requests);
+    //==============================
+    // Compute Internal
+    //==============================
+    SpMMInternal(A, X, Y);
+    //==============================
+    // Wait Asynchronous Communication
+    //==============================
+    if (X.numberOfRecvRequests) {
+        if (MPI_Waitall(X.numberOfRecvRequests, X.requests, MPI_STATUSES_IGNORE)) {
+            std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
+            std::exit(-1);
+        }
+    }
+    //==============================
+    // Compute External
+    //==============================
+    SpMMExternal(A, X, Y);
+    if (X.numberOfSendRequests) {
+        if (MPI_Waitall(X.numberOfSendRequests, X.requests + X.numberOfRecvRequests, MPI_STATUSES_IGNORE)) {
+            std::cerr << "exit in " << __FILE__ << ":" << __LINE__ << std::endl;
+            std::exit(-1);
+        }
+    }
+    return 0;
+}
+
+
+// y = A^T x on the same partition. Only the local part of x is read: the contributions to
+// the external columns are sent back to their owners by the reverse halo exchange.
+// The scatter schedule must have been created (CreateScatterSchedule).
+int SpMVTranspose (const SparseMatrix &A, Vector &x, Vector &y) {
+    if (A.symmetric) return SpMV_no_overlap(A, x, y);
+    SpMVTransposeExternal(A, x);
+    SpMVTransposeInternal(A, x, y);
+    ReverseHaloExchange(A, A.transposeBuffer, y);
+    return 0;
+}
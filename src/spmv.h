@@ -4,4 +4,7 @@
 //int SpMV (const SparseMatrix &A, Vector &x, Vector &y);
 int SpMV_overlap (const SparseMatrix &A, Vector &x, Vector &y);
 int SpMV_no_overlap (const SparseMatrix &A, Vector &x, Vector &y);
-int SpMV_measurement_once (const SparseMatrix &A, Vector &x, Vector &y);
+int SpMV_measurement_once (const SparseMatrix &A, const SparseMatrix &buffered, Vector &x, Vector &y);
+void ReverseHaloExchange (const SparseMatrix &A, const double *contribution, Vector &y);
+int SpMM (const SparseMatrix &A, MultiVector &X, MultiVector &Y);
+int SpMVTranspose (const SparseMatrix &A, Vector &x, Vector &y);
@@ -1,10 +1,18 @@
 #include <mpi.h>
 #include <iostream>
 #include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "spmv_kernel.h"
 #include "sparse_matrix.h"
 #include "vector.h"
-#if defined(MIC) || defined(CPU)
+#include "util.h"
+#include "autotune.h"
+#include "csr_kernel.h"
+#if (defined(MIC) || defined(CPU)) && !defined(MY_CSRMV)
 #include <mkl.h>
 #endif
 #ifdef GPU
@@ -14,36 +22,220 @@
 #endif
 using namespace std;
 
-void my_dcsrmv (double coef, int nRow, int *ptr, int *idx, double *val, double *xv, double *yv) {
-#pragma omp parallel for
-    for (int i = 0; i < nRow; i++) {
-        yv[i] += coef;
-        for (int j = ptr[i]; j < ptr[i+1]; j++) {
-            yv[i] += val[j] * xv[idx[j]];
-        }
+static const char *formatNames[] = {"csr", "sell", "merge", "bcsr", "dcsr"};
+static const int numberOfFormats = sizeof(formatNames) / sizeof(formatNames[0]);
+
+const char* GetStorageFormatName (int format) {
+    return formatNames[format];
+}
+
+static int GetStorageFormat (const string &name) {
+    for (int f = 0; f < numberOfFormats; f++) {
+        if (name == formatNames[f]) return f;
+    }
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) cerr << "Unknown storage format : " << name << endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+    return FORMAT_CSR;
+}
+
+// The block size is given by SPMV_BCSR_BLOCK ("RxC") or selected from the sampled fill.
+// The block stays on CSR when blocking does not pay off.
+static void CreateBcsrBlock (BcsrMatrix &B, int &format, int nRow, int nCol, const int *ptr, const int *idx, const double *val) {
+    int r, c;
+    string block = GetEnvOption("SPMV_BCSR_BLOCK", "auto");
+    if (block == "auto" || sscanf(block.c_str(), "%dx%d", &r, &c) != 2) {
+        SelectBcsrBlockSize(nRow, nCol, ptr, idx, r, c);
+    } else if (!IsSupportedBcsrBlockSize(r, c) || c > nCol) {
+        SelectBcsrBlockSize(nRow, nCol, ptr, idx, r, c);
+    }
+    if (r == 1 && c == 1) {
+        format = FORMAT_CSR;
+        return;
+    }
+    CreateBcsrMatrix(B, nRow, nCol, ptr, idx, val, r, c);
+}
+
+// Create the arrays of the format of one block, a BCSR block may fall back to CSR
+void CreateBlockFormat (SparseMatrix & A, bool internal) {
+    int &format = internal ? A.internalFormat : A.externalFormat;
+    const int nRow = A.localNumberOfRows;
+    const int nCol = internal ? A.localNumberOfRows : A.totalNumberOfUsedCols;
+    const int *ptr = internal ? A.internalPtr : A.externalPtr;
+    const int *idx = internal ? A.internalIdx : A.externalIdx;
+    const double *val = internal ? A.internalVal : A.externalVal;
+    if (format == FORMAT_SELL) {
+        int sigma = atoi(GetEnvOption("SPMV_SELL_SIGMA", to_string(static_cast<long long>(SELL_DEFAULT_SIGMA))).c_str());
+        CreateSellMatrix(internal ? A.internalSell : A.externalSell, nRow, ptr, idx, val, sigma);
+    } else if (format == FORMAT_MERGE) {
+        CreateMergePathSchedule(internal ? A.internalMerge : A.externalMerge, nRow, ptr);
+    } else if (format == FORMAT_BCSR) {
+        CreateBcsrBlock(internal ? A.internalBcsr : A.externalBcsr, format, nRow, nCol, ptr, idx, val);
+    } else if (format == FORMAT_DCSR) {
+        CreateDcsrMatrix(internal ? A.internalDcsr : A.externalDcsr, nRow, ptr);
+    }
+}
+
+void DeleteBlockFormat (SparseMatrix & A, bool internal) {
+    int format = internal ? A.internalFormat : A.externalFormat;
+    if (format == FORMAT_SELL) DeleteSellMatrix(internal ? A.internalSell : A.externalSell);
+    if (format == FORMAT_MERGE) DeleteMergePathSchedule(internal ? A.internalMerge : A.externalMerge);
+    if (format == FORMAT_BCSR) DeleteBcsrMatrix(internal ? A.internalBcsr : A.externalBcsr);
+    if (format == FORMAT_DCSR) DeleteDcsrMatrix(internal ? A.internalDcsr : A.externalDcsr);
+}
+
+static const char *scheduleNames[] = {"static", "dynamic"};
+static const int numberOfSchedules = sizeof(scheduleNames) / sizeof(scheduleNames[0]);
+
+const char* GetLoopScheduleName (int schedule) {
+    return scheduleNames[schedule];
+}
+
+static int GetLoopSchedule (const string &name) {
+    for (int s = 0; s < numberOfSchedules; s++) {
+        if (name == scheduleNames[s]) return s;
+    }
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    if (rank == 0) cerr << "Unknown schedule : " << name << endl;
+    MPI_Abort(MPI_COMM_WORLD, 1);
+    return SCHEDULE_STATIC;
+}
+
+// The row (chunk) loops of the SELL, BCSR, DCSR and SpMM kernels use schedule(runtime)
+static inline void SetLoopSchedule (int schedule) {
+#ifdef _OPENMP
+    if (schedule == SCHEDULE_DYNAMIC) omp_set_schedule(omp_sched_dynamic, SCHEDULE_DYNAMIC_CHUNK);
+    else omp_set_schedule(omp_sched_static, 0);
+#endif
+}
+
+// SPMV_FORMAT selects the format of both blocks ('auto' runs the autotuner),
+// SPMV_INTERNAL_FORMAT and SPMV_EXTERNAL_FORMAT override it for one block.
+// SPMV_SCHEDULE selects the OpenMP schedule of the row loops.
+// Returns true if a block has been autotuned.
+bool CreateStorageFormat (SparseMatrix & A, Vector & x, Vector & y) {
+    string format = GetEnvOption("SPMV_FORMAT", "csr");
+    string internalFormat = GetEnvOption("SPMV_INTERNAL_FORMAT", format);
+    string externalFormat = GetEnvOption("SPMV_EXTERNAL_FORMAT", format);
+    A.internalSchedule = A.externalSchedule = GetLoopSchedule(GetEnvOption("SPMV_SCHEDULE", "static"));
+    A.internalFormat = internalFormat == "auto" ? FORMAT_CSR : GetStorageFormat(internalFormat);
+    A.externalFormat = externalFormat == "auto" ? FORMAT_CSR : GetStorageFormat(externalFormat);
+    bool tuneInternal = internalFormat == "auto", tuneExternal = externalFormat == "auto";
+#ifdef GPU
+    A.internalFormat = A.externalFormat = FORMAT_CSR;
+    tuneInternal = tuneExternal = false;
+#endif
+    // the symmetric kernels work on CSR
+    if (A.symmetric) {
+        A.internalFormat = A.externalFormat = FORMAT_CSR;
+        tuneInternal = tuneExternal = false;
+    }
+    CreateBlockFormat(A, true);
+    CreateBlockFormat(A, false);
+    if (tuneInternal) AutotuneBlockFormat(A, x, y, true);
+    if (tuneExternal) AutotuneBlockFormat(A, x, y, false);
+    return tuneInternal || tuneExternal;
+}
+
+#ifdef MKL_INSPECTOR_EXECUTOR
+static sparse_matrix_t CreateMklHandle (int nRow, int nCol, int *ptr, int *idx, double *val, int expectedCalls) {
+    sparse_matrix_t handle = NULL;
+    if (ptr[nRow] == 0) return NULL;
+    struct matrix_descr descr;
+    descr.type = SPARSE_MATRIX_TYPE_GENERAL;
+    if (mkl_sparse_d_create_csr(&handle, SPARSE_INDEX_BASE_ZERO, nRow, nCol, ptr, ptr + 1, idx, val) != SPARSE_STATUS_SUCCESS) {
+        cerr << "mkl_sparse_d_create_csr failed" << endl;
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    mkl_sparse_set_mv_hint(handle, SPARSE_OPERATION_NON_TRANSPOSE, descr, expectedCalls);
+    // the legacy path is used when MKL cannot optimize the block
+    if (mkl_sparse_optimize(handle) != SPARSE_STATUS_SUCCESS) {
+        mkl_sparse_destroy(handle);
+        return NULL;
+    }
+    return handle;
+}
+#endif
+
+// SPMV_MKL_EXPECTED_CALLS is the number of SpMV hinted to the inspector
+double CreateMklHandles (SparseMatrix & A) {
+#ifdef MKL_INSPECTOR_EXECUTOR
+    A.internalHandle = A.externalHandle = NULL;
+    double begin = MPI_Wtime();
+    int expectedCalls = atoi(GetEnvOption("SPMV_MKL_EXPECTED_CALLS", to_string(static_cast<long long>(MKL_DEFAULT_EXPECTED_CALLS))).c_str());
+    const int nRow = A.localNumberOfRows;
+    if (A.internalFormat == FORMAT_CSR && !A.symmetric) {
+        A.internalHandle = CreateMklHandle(nRow, nRow, A.internalPtr, A.internalIdx, A.internalVal, expectedCalls);
+    }
+    if (A.externalFormat == FORMAT_CSR && !A.symmetric) {
+        A.externalHandle = CreateMklHandle(nRow, A.totalNumberOfUsedCols, A.externalPtr, A.externalIdx, A.externalVal, expectedCalls);
     }
+    return MPI_Wtime() - begin;
+#else
+    return 0;
+#endif
+}
+
+void DestroyMklHandles (SparseMatrix & A) {
+#ifdef MKL_INSPECTOR_EXECUTOR
+    if (A.internalHandle) mkl_sparse_destroy(A.internalHandle);
+    if (A.externalHandle) mkl_sparse_destroy(A.externalHandle);
+    A.internalHandle = A.externalHandle = NULL;
+#endif
 }
 
 int SpMVInternal (const SparseMatrix & A, Vector & x, Vector & y) {
+    if (A.symmetric) return SpMVSymmetricInternal(A, x, y);
+    SetLoopSchedule(A.internalSchedule);
+    if (A.internalFormat == FORMAT_SELL) {
+        SellMV(A.internalSell, x.values, y.values, false);
+        return 0;
+    }
+    if (A.internalFormat == FORMAT_MERGE) {
+        MergePathMV(A.internalMerge, A.localNumberOfRows, A.internalPtr, A.internalIdx, A.internalVal, x.values, y.values, false);
+        return 0;
+    }
+    if (A.internalFormat == FORMAT_BCSR) {
+        BcsrMV(A.internalBcsr, x.values, y.values, false);
+        return 0;
+    }
+    if (A.internalFormat == FORMAT_DCSR) {
+        DcsrMV(A.internalDcsr, A.internalIdx, A.internalVal, x.values, y.values, false);
+        return 0;
+    }
     double *xv = x.values;
     double *yv = y.values;
     double ALPHA = 1;
     double BETA = 0;
     int nRow = A.localNumberOfRows;
     int nNnz = A.internalPtr[nRow];
-    if (nNnz == 0) return 0;
+    if (nNnz == 0) {
+        // BETA = 0 : y is overwritten even without an internal nonzero
+        fill(yv, yv + nRow, 0);
+        return 0;
+    }
+#ifdef MKL_INSPECTOR_EXECUTOR
+    if (A.internalHandle) {
+        struct matrix_descr descr;
+        descr.type = SPARSE_MATRIX_TYPE_GENERAL;
+        mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, ALPHA, A.internalHandle, descr, xv, BETA, yv);
+        return 0;
+    }
+#endif
 #if defined(MIC) || defined(CPU)
     int *ptr = A.internalPtr;
     int *idx = A.internalIdx;
     double *val = A.internalVal;
+#ifndef MY_CSRMV
     MKL_INT *ptr_b = static_cast<MKL_INT*>(ptr);
     MKL_INT *ptr_e = ptr_b + 1;
     char transa = 'N';
     char *matdescra = "GLNC";
-#ifndef MY_CSRMV
     mkl_dcsrmv(&transa, &nRow, &nRow, &ALPHA, matdescra, val, idx, ptr_b, ptr_e, xv, &BETA, yv);
 #else
-    my_dcsrmv(BETA, nRow, ptr, idx, val, xv, yv);
+    CsrMV(nRow, ptr, idx, val, ALPHA, xv, BETA, yv);
 #endif
 #endif
 #ifdef GPU
@@ -109,6 +301,24 @@ int SpMVDenseInternal (const SparseMatrix & A, Vector & x, Vector & y) {
 
 
 int SpMVExternal (const SparseMatrix & A, Vector & x, Vector & y) {
+    if (A.symmetric) return SpMVSymmetricExternal(A, x, y);
+    SetLoopSchedule(A.externalSchedule);
+    if (A.externalFormat == FORMAT_SELL) {
+        SellMV(A.externalSell, x.values, y.values, true);
+        return 0;
+    }
+    if (A.externalFormat == FORMAT_MERGE) {
+        MergePathMV(A.externalMerge, A.localNumberOfRows, A.externalPtr, A.externalIdx, A.externalVal, x.values, y.values, true);
+        return 0;
+    }
+    if (A.externalFormat == FORMAT_BCSR) {
+        BcsrMV(A.externalBcsr, x.values, y.values, true);
+        return 0;
+    }
+    if (A.externalFormat == FORMAT_DCSR) {
+        DcsrMV(A.externalDcsr, A.externalIdx, A.externalVal, x.values, y.values, true);
+        return 0;
+    }
     double *xv = x.values;
     double *yv = y.values;
     double ALPHA = 1;
@@ -117,18 +327,26 @@ int SpMVExternal (const SparseMatrix & A, Vector & x, Vector & y) {
     int nCol = A.localNumberOfRows + A.totalNumberOfRecv;
     int nNnz = A.externalPtr[nRow];
     if (nNnz == 0) return 0;
+#ifdef MKL_INSPECTOR_EXECUTOR
+    if (A.externalHandle) {
+        struct matrix_descr descr;
+        descr.type = SPARSE_MATRIX_TYPE_GENERAL;
+        mkl_sparse_d_mv(SPARSE_OPERATION_NON_TRANSPOSE, ALPHA, A.externalHandle, descr, xv, BETA, yv);
+        return 0;
+    }
+#endif
 #if defined(MIC) || defined(CPU)
     int *ptr = A.externalPtr;
     int *idx = A.externalIdx;
     double *val = A.externalVal;
+#ifndef MY_CSRMV
     MKL_INT *ptr_b = static_cast<MKL_INT*>(ptr);
     MKL_INT *ptr_e = ptr_b + 1;
     char transa = 'N';
     char *matdescra = "GLNC";
-#ifndef MY_CSRMV
     mkl_dcsrmv(&transa, &nRow, &nCol, &ALPHA, matdescra, val, idx, ptr_b, ptr_e, xv, &BETA, yv);
 #else
-    my_dcsrmv(BETA, nRow, ptr, idx, val, xv, yv);
+    CsrMV(nRow, ptr, idx, val, ALPHA, xv, BETA, yv);
 #endif
 
 #endif
@@ -155,3 +373,225 @@ int SpMVExternal (const SparseMatrix & A, Vector & x, Vector & y) {
     return 0;
 }
 
+
+//==============================
+// Symmetric (lower triangle) storage
+//==============================
+// Rows are split into blocks of about the same number of nonzeros, one per thread.
+// The window of a thread covers every row it updates through the transpose.
+// Thread row blocks balanced by the nonzeros of the internal block, their scatter windows
+// and transposeBuffer. Used by the symmetric and the transpose kernels.
+void CreateScatterSchedule (SparseMatrix & A) {
+#ifdef _OPENMP
+    int nThread = omp_get_max_threads();
+#else
+    int nThread = 1;
+#endif
+    const int nRow = A.localNumberOfRows;
+    const int *ptr = A.internalPtr;
+    const int *idx = A.internalIdx;
+    A.numberOfScatterThreads = nThread;
+    A.scatterRowBegin = new int[nThread + 1];
+    A.scatterWindowBegin = new int[nThread];
+    A.scatterWindowEnd = new int[nThread];
+    A.scatterOffset = new long long[nThread + 1];
+    A.scatterRowBegin[0] = 0;
+    for (int t = 1; t < nThread; t++) {
+        long long target = (long long) ptr[nRow] * t / nThread;
+        A.scatterRowBegin[t] = max(A.scatterRowBegin[t-1], (int) (lower_bound(ptr, ptr + nRow + 1, target) - ptr));
+    }
+    A.scatterRowBegin[nThread] = nRow;
+    A.scatterOffset[0] = 0;
+    for (int t = 0; t < nThread; t++) {
+        int begin = nRow, end = 0;
+        for (int j = ptr[A.scatterRowBegin[t]]; j < ptr[A.scatterRowBegin[t+1]]; j++) {
+            begin = min(begin, idx[j]);
+            end = max(end, idx[j] + 1);
+        }
+        A.scatterWindowBegin[t] = min(begin, end);
+        A.scatterWindowEnd[t] = end;
+        A.scatterOffset[t+1] = A.scatterOffset[t] + (end - A.scatterWindowBegin[t]);
+    }
+    A.scatterBuffer = new double[A.scatterOffset[nThread]];
+    A.transposeBuffer = new double[A.totalNumberOfRecv];
+}
+
+// Adds the windows of the other row blocks over the rows of the block t
+static inline void GatherScatterWindows (const SparseMatrix & A, int t, double *yv) {
+    const int rowBegin = A.scatterRowBegin[t], rowEnd = A.scatterRowBegin[t+1];
+    for (int s = 0; s < A.numberOfScatterThreads; s++) {
+        if (s == t) continue;
+        const int begin = max(rowBegin, A.scatterWindowBegin[s]);
+        const int end = min(rowEnd, A.scatterWindowEnd[s]);
+        const double *other = A.scatterBuffer + A.scatterOffset[s] - A.scatterWindowBegin[s];
+        for (int r = begin; r < end; r++) yv[r] += other[r];
+    }
+}
+
+// The team may be smaller than the schedule (OMP_DYNAMIC, thread limit, nesting) :
+// a thread takes the row blocks tid, tid + nTeam, ...
+#ifdef _OPENMP
+#define SCATTER_TEAM(tid, nTeam) const int tid = omp_get_thread_num(), nTeam = omp_get_num_threads()
+#else
+#define SCATTER_TEAM(tid, nTeam) const int tid = 0, nTeam = 1
+#endif
+
+// y = (L + L^T - D) x on the internal block, y is overwritten
+int SpMVSymmetricInternal (const SparseMatrix & A, Vector & x, Vector & y) {
+    const double *xv = x.values;
+    double *yv = y.values;
+    const int *ptr = A.internalPtr;
+    const int *idx = A.internalIdx;
+    const double *val = A.internalVal;
+    const int nChunk = A.numberOfScatterThreads;
+#pragma omp parallel num_threads(nChunk)
+    {
+        SCATTER_TEAM(tid, nTeam);
+        for (int t = tid; t < nChunk; t += nTeam) {
+            const int rowBegin = A.scatterRowBegin[t], rowEnd = A.scatterRowBegin[t+1];
+            const int windowBegin = A.scatterWindowBegin[t];
+            double *window = A.scatterBuffer + A.scatterOffset[t] - windowBegin;
+            fill(yv + rowBegin, yv + rowEnd, 0);
+            fill(window + windowBegin, window + A.scatterWindowEnd[t], 0);
+            for (int i = rowBegin; i < rowEnd; i++) {
+                const double xi = xv[i];
+                double sum = 0;
+                for (int j = ptr[i]; j < ptr[i+1]; j++) {
+                    const int c = idx[j];
+                    sum += val[j] * xv[c];
+                    if (c == i) continue;
+                    if (rowBegin <= c && c < rowEnd) yv[c] += val[j] * xi;
+                    else window[c] += val[j] * xi;
+                }
+                yv[i] += sum;
+            }
+        }
+#pragma omp barrier
+        // each block collects the windows of the others over its own rows
+        for (int t = tid; t < nChunk; t += nTeam) GatherScatterWindows(A, t, yv);
+    }
+    return 0;
+}
+
+// y = A_internal^T x, y is overwritten (same scatter as SpMVSymmetricInternal)
+int SpMVTransposeInternal (const SparseMatrix & A, Vector & x, Vector & y) {
+    const double *xv = x.values;
+    double *yv = y.values;
+    const int *ptr = A.internalPtr;
+    const int *idx = A.internalIdx;
+    const double *val = A.internalVal;
+    const int nChunk = A.numberOfScatterThreads;
+#pragma omp parallel num_threads(nChunk)
+    {
+        SCATTER_TEAM(tid, nTeam);
+        for (int t = tid; t < nChunk; t += nTeam) {
+            const int rowBegin = A.scatterRowBegin[t], rowEnd = A.scatterRowBegin[t+1];
+            const int windowBegin = A.scatterWindowBegin[t];
+            double *window = A.scatterBuffer + A.scatterOffset[t] - windowBegin;
+            fill(yv + rowBegin, yv + rowEnd, 0);
+            fill(window + windowBegin, window + A.scatterWindowEnd[t], 0);
+            for (int i = rowBegin; i < rowEnd; i++) {
+                const double xi = xv[i];
+                for (int j = ptr[i]; j < ptr[i+1]; j++) {
+                    const int c = idx[j];
+                    if (rowBegin <= c && c < rowEnd) yv[c] += val[j] * xi;
+                    else window[c] += val[j] * xi;
+                }
+            }
+        }
+#pragma omp barrier
+        for (int t = tid; t < nChunk; t += nTeam) GatherScatterWindows(A, t, yv);
+    }
+    return 0;
+}
+
+// transposeBuffer = A_external^T x (sent back by ReverseHaloExchange)
+int SpMVTransposeExternal (const SparseMatrix & A, Vector & x) {
+    const double *xv = x.values;
+    const int nRow = A.localNumberOfRows;
+    const int *ptr = A.externalPtr;
+    const int *idx = A.externalIdx;
+    const double *val = A.externalVal;
+    double *transpose = A.transposeBuffer - nRow;
+    fill(A.transposeBuffer, A.transposeBuffer + A.totalNumberOfRecv, 0);
+#pragma omp parallel for
+    for (int i = 0; i < nRow; i++) {
+        const double xi = xv[i];
+        for (int j = ptr[i]; j < ptr[i+1]; j++) {
+#pragma omp atomic
+            transpose[idx[j]] += val[j] * xi;
+        }
+    }
+    return 0;
+}
+
+// y += L_external x, transposeBuffer = L_external^T x (sent back by ReverseHaloExchange)
+int SpMVSymmetricExternal (const SparseMatrix & A, Vector & x, Vector & y) {
+    const double *xv = x.values;
+    double *yv = y.values;
+    const int nRow = A.localNumberOfRows;
+    const int *ptr = A.externalPtr;
+    const int *idx = A.externalIdx;
+    const double *val = A.externalVal;
+    double *transpose = A.transposeBuffer - nRow;
+    fill(A.transposeBuffer, A.transposeBuffer + A.totalNumberOfRecv, 0);
+#pragma omp parallel for
+    for (int i = 0; i < nRow; i++) {
+        const double xi = xv[i];
+        double sum = 0;
+        for (int j = ptr[i]; j < ptr[i+1]; j++) {
+            sum += val[j] * xv[idx[j]];
+#pragma omp atomic
+            transpose[idx[j]] += val[j] * xi;
+        }
+        yv[i] += sum;
+    }
+    return 0;
+}
+
+
+//==============================
+// SpMM (k vectors, row major)
+//==============================
+// K > 0 fixes the number of vectors at compile time so that the vector loop is unrolled
+template<int K>
+static void CsrMM (int nRow, const int *ptr, const int *idx, const double *val, int k, const double *X, double *Y, bool accumulate) {
+    if (K) k = K;
+#pragma omp parallel for schedule(runtime)
+    for (int i = 0; i < nRow; i++) {
+        double *y = Y + (long long) i * k;
+        if (!accumulate) {
+            for (int v = 0; v < k; v++) y[v] = 0;
+        }
+        for (int j = ptr[i]; j < ptr[i+1]; j++) {
+            const double a = val[j];
+            const double *x = X + (long long) idx[j] * k;
+#pragma omp simd
+            for (int v = 0; v < k; v++) y[v] += a * x[v];
+        }
+    }
+}
+
+static void CsrMM (int nRow, const int *ptr, const int *idx, const double *val, int k, const double *X, double *Y, bool accumulate) {
+    switch (k) {
+        case 1: CsrMM<1>(nRow, ptr, idx, val, k, X, Y, accumulate); break;
+        case 2: CsrMM<2>(nRow, ptr, idx, val, k, X, Y, accumulate); break;
+        case 4: CsrMM<4>(nRow, ptr, idx, val, k, X, Y, accumulate); break;
+        case 8: CsrMM<8>(nRow, ptr, idx, val, k, X, Y, accumulate); break;
+        case 16: CsrMM<16>(nRow, ptr, idx, val, k, X, Y, accumulate); break;
+        case 32: CsrMM<32>(nRow, ptr, idx, val, k, X, Y, accumulate); break;
+        default: CsrMM<0>(nRow, ptr, idx, val, k, X, Y, accumulate); break;
+    }
+}
+
+int SpMMInternal (const SparseMatrix & A, MultiVector & X, MultiVector & Y) {
+    SetLoopSchedule(A.internalSchedule);
+    CsrMM(A.localNumberOfRows, A.internalPtr, A.internalIdx, A.internalVal, X.numberOfVectors, X.values, Y.values, false);
+    return 0;
+}
+
+int SpMMExternal (const SparseMatrix & A, MultiVector & X, MultiVector & Y) {
+    SetLoopSchedule(A.externalSchedule);
+    CsrMM(A.localNumberOfRows, A.externalPtr, A.externalIdx, A.externalVal, X.numberOfVectors, X.values, Y.values, true);
+    return 0;
+}
@@ -1,4 +1,4 @@
-#if defined(CPU) || defined(MIC)
+#if (defined(CPU) || defined(MIC)) && !defined(MY_CSRMV)
 #include <mkl.h>
 #endif
 #include "sparse_matrix.h"
@@ -6,3 +6,19 @@
 int SpMVInternal (const SparseMatrix & A, Vector & x, Vector & y);
 int SpMVExternal (const SparseMatrix & A, Vector & x, Vector & y);
 int SpMVDenseInternal (const SparseMatrix & A, Vector & x, Vector & y);
+// Y = A_internal X and Y += A_external X on the CSR arrays, every nonzero is read once for the k vectors
+int SpMMInternal (const SparseMatrix & A, MultiVector & X, MultiVector & Y);
+int SpMMExternal (const SparseMatrix & A, MultiVector & X, MultiVector & Y);
+bool CreateStorageFormat (SparseMatrix & A, Vector & x, Vector & y);
+// Inspector-executor handles of the CSR blocks, returns the inspection time (0 without MKL)
+double CreateMklHandles (SparseMatrix & A);
+void DestroyMklHandles (SparseMatrix & A);
+void CreateBlockFormat (SparseMatrix & A, bool internal);
+void DeleteBlockFormat (SparseMatrix & A, bool internal);
+const char* GetStorageFormatName (int format);
+const char* GetLoopScheduleName (int schedule);
+void CreateScatterSchedule (SparseMatrix & A);
+int SpMVSymmetricInternal (const SparseMatrix & A, Vector & x, Vector & y);
+int SpMVSymmetricExternal (const SparseMatrix & A, Vector & x, Vector & y);
+int SpMVTransposeInternal (const SparseMatrix & A, Vector & x, Vector & y);
+int SpMVTransposeExternal (const SparseMatrix & A, Vector & x);
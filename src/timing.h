@@ -15,5 +15,6 @@ using namespace std;
 #define TIMING_PACKING                      12
 #define TIMING_INTERNAL_COMPUTATION         13
 #define TIMING_EXTERNAL_COMPUTATION         14
+#define TIMING_BUFFER_COMMUNICATION         15
 
 extern vector<double> timingTemp;
@@ -1,5 +1,16 @@
 #include <algorithm>
 #include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "util.h"
 using namespace std;
 string GetBasename (const string &path) {
@@ -7,31 +18,242 @@ string GetBasename (const string &path) {
     return path.substr(p+1);
 }
 
+//------------------------------------------
+// Matrix Market parser
+//------------------------------------------
+static inline bool IsBlank (char c) { return c == ' ' || c == '\t' || c == '\r'; }
 
-vector<Element> GetElementsFromFile (const string &mtxFile, int &nRow, int &nCol, int &nNnz) {
-    ifstream ifs(mtxFile.c_str());
-    if (ifs.fail()) {
-        cerr << "File not Found" << endl;
-        exit(1);
+static inline const char* ParseInt (const char *p, const char *end, int &v) {
+    while (p < end && IsBlank(*p)) p++;
+    int r = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) r = r * 10 + (*p++ - '0');
+    v = r;
+    return p;
+}
+
+// Fast path is exact when the decimal mantissa fits into 53 bits and 10^|exponent| is exact
+// (Clinger's fast path). Other numbers are handed to strtod.
+static inline const char* ParseDouble (const char *p, const char *end, double &v) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    while (p < end && IsBlank(*p)) p++;
+    const char *begin = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+    uint64_t mantissa = 0;
+    int nDigit = 0, exponent = 0;
+    while (p < end && (unsigned)(*p - '0') < 10) {
+        if (nDigit < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) nDigit++; }
+        else exponent++;
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        while (p < end && (unsigned)(*p - '0') < 10) {
+            if (nDigit < 19) { mantissa = mantissa * 10 + (*p - '0'); if (mantissa) nDigit++; exponent--; }
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E' || *p == 'd' || *p == 'D')) {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')) negativeExponent = (*p++ == '-');
+        int e = 0;
+        while (p < end && (unsigned)(*p - '0') < 10) { if (e < 100000) e = e * 10 + (*p - '0'); p++; }
+        exponent += negativeExponent ? -e : e;
     }
-    string line;
-    do {
-        getline(ifs, line);
-    } while (line[0] == '%');
+    if (nDigit < 19 && mantissa < (1ULL << 53) && -22 <= exponent && exponent <= 22) {
+        double d = (double) mantissa;
+        d = exponent < 0 ? d / pow10[-exponent] : d * pow10[exponent];
+        v = negative ? -d : d;
+        return p;
+    }
+    char buf[128];
+    int len = min<long>(p - begin, sizeof(buf) - 1);
+    memcpy(buf, begin, len);
+    buf[len] = '\0';
+    v = strtod(buf, NULL);
+    return p;
+}
+
+// "%%MatrixMarket matrix coordinate real symmetric" : only one triangle is stored in the file
+bool IsSymmetricBanner (const char *begin, const char *end) {
+    const char *eol = (const char *) memchr(begin, '\n', end - begin);
+    string line(begin, eol ? eol : end);
+    if (line.compare(0, 14, "%%MatrixMarket") != 0) return false;
     stringstream ss(line);
-    ss >> nRow >> nCol >> nNnz;
-    assert(nRow == nCol);
-    vector<Element> elements(nNnz);
-    for (int i = 0; i < nNnz; i++) {
+    string banner, object, format, field, symmetry;
+    ss >> banner >> object >> format >> field >> symmetry;
+    transform(symmetry.begin(), symmetry.end(), symmetry.begin(), ::tolower);
+    if (symmetry == "skew-symmetric" || symmetry == "hermitian") {
+        cerr << "Unsupported symmetry : " << symmetry << endl;
+        exit(1);
+    }
+    return symmetry == "symmetric";
+}
+
+// Parse "row col val" lines in [begin, end), begin and end are line aligned
+void ParseMatrixMarketElements (const char *begin, const char *end, vector<Element> &elements) {
+    const char *p = begin;
+    while (p < end) {
+        while (p < end && (IsBlank(*p) || *p == '\n')) p++;
+        if (p == end) break;
+        if (*p == '%') {
+            while (p < end && *p != '\n') p++;
+            continue;
+        }
         int row, col;
         double val;
-        ifs >> row >> col >> val;
-        row--; col--; 
-        elements[i] = Element(row, col, val);
+        p = ParseInt(p, end, row);
+        p = ParseInt(p, end, col);
+        p = ParseDouble(p, end, val);
+        elements.push_back(Element(row - 1, col - 1, val));
+        while (p < end && *p != '\n') p++;
     }
-    sort(elements.begin(), elements.end(), RowComparator());
-    return elements;
 }
 
+string GetEnvOption (const char *name, const string &defaultValue) {
+    const char *value = getenv(name);
+    return value != NULL && *value != '\0' ? string(value) : defaultValue;
+}
 
+static inline int GetNumberOfThreads () {
+#ifdef _OPENMP
+    return omp_get_max_threads();
+#else
+    return 1;
+#endif
+}
 
+// The file is split into line aligned chunks which are parsed in parallel,
+// then the elements are sorted by (row, col) with a counting sort on row.
+// A symmetric matrix is expanded to the general form (nNnz counts both triangles).
+vector<Element> GetElementsFromFile (const string &mtxFile, int &nRow, int &nCol, int &nNnz, bool *symmetric) {
+    int fd = open(mtxFile.c_str(), O_RDONLY);
+    if (fd < 0) {
+        cerr << "File not Found" << endl;
+        exit(1);
+    }
+    struct stat st;
+    fstat(fd, &st);
+    size_t fileSize = st.st_size;
+    const char *data = (const char *) mmap(NULL, max<size_t>(fileSize, 1), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        cerr << "Cannot map " << mtxFile << endl;
+        exit(1);
+    }
+    const char *end = data + fileSize;
+
+    //------------------------------------------
+    // Header
+    //------------------------------------------
+    const bool isSymmetric = IsSymmetricBanner(data, end);
+    if (symmetric != NULL) *symmetric = isSymmetric;
+    const char *p = data;
+    while (p < end && *p == '%') {
+        p = (const char *) memchr(p, '\n', end - p);
+        p = p ? p + 1 : end;
+    }
+    const char *eol = (const char *) memchr(p, '\n', end - p);
+    if (eol == NULL) eol = end;
+    stringstream ss(string(p, eol));
+    ss >> nRow >> nCol >> nNnz;
+    assert(nRow == nCol);
+    const char *body = eol < end ? eol + 1 : end;
+
+    //------------------------------------------
+    // Parse
+    //------------------------------------------
+    const int nThread = GetNumberOfThreads();
+    vector< vector<Element> > parsed(nThread);
+    vector<const char*> chunk(nThread + 1);
+    chunk[0] = body;
+    chunk[nThread] = end;
+    for (int t = 1; t < nThread; t++) {
+        const char *c = body + (end - body) * t / nThread;
+        if (c < chunk[t-1]) c = chunk[t-1];
+        const char *n = c > body ? (const char *) memchr(c - 1, '\n', end - (c - 1)) : c - 1;
+        chunk[t] = n ? n + 1 : end;
+    }
+    // the chunks are distributed over the threads that are actually given
+#pragma omp parallel for schedule(static, 1) num_threads(nThread)
+    for (int t = 0; t < nThread; t++) {
+        parsed[t].reserve((size_t) nNnz / nThread + 16);
+        ParseMatrixMarketElements(chunk[t], chunk[t+1], parsed[t]);
+    }
+    munmap((void *) data, max<size_t>(fileSize, 1));
+    size_t nParsed = 0;
+    for (int t = 0; t < nThread; t++) nParsed += parsed[t].size();
+    if (nParsed != (size_t) nNnz) {
+        cerr << mtxFile << ": expected " << nNnz << " nonzeros, found " << nParsed << endl;
+        exit(1);
+    }
+    if (isSymmetric) {
+#pragma omp parallel for schedule(static, 1) num_threads(nThread)
+        for (int t = 0; t < nThread; t++) {
+            vector<Element> &local = parsed[t];
+            size_t n = local.size();
+            for (size_t i = 0; i < n; i++) {
+                if (local[i].row != local[i].col) local.push_back(Element(local[i].col, local[i].row, local[i].val));
+            }
+        }
+        nNnz = 0;
+        for (int t = 0; t < nThread; t++) nNnz += parsed[t].size();
+    }
+
+    //------------------------------------------
+    // Counting sort by row, then sort each row by col
+    //------------------------------------------
+    // count[t][r] : elements of row r in chunk t, turned into the position of the first of them
+    // (rows in order, chunks in order within a row) so that every chunk scatters on its own
+    vector< vector<int> > count(nThread);
+    vector<int> outOfRange(nThread, -1);
+#pragma omp parallel for schedule(static, 1) num_threads(nThread)
+    for (int t = 0; t < nThread; t++) {
+        const vector<Element> &local = parsed[t];
+        count[t].assign(nRow, 0);
+        for (size_t i = 0; i < local.size(); i++) {
+            const Element &e = local[i];
+            if (e.row < 0 || e.row >= nRow || e.col < 0 || e.col >= nCol) {
+                outOfRange[t] = i;
+                break;
+            }
+            count[t][e.row]++;
+        }
+    }
+    for (int t = 0; t < nThread; t++) {
+        if (outOfRange[t] < 0) continue;
+        const Element &e = parsed[t][outOfRange[t]];
+        cerr << mtxFile << ": index out of range (" << e.row + 1 << ", " << e.col + 1 << ")" << endl;
+        exit(1);
+    }
+    vector<int> ptr(nRow + 1, 0);
+#pragma omp parallel for schedule(static) num_threads(nThread)
+    for (int i = 0; i < nRow; i++) {
+        for (int t = 0; t < nThread; t++) ptr[i+1] += count[t][i];
+    }
+    for (int i = 0; i < nRow; i++) ptr[i+1] += ptr[i];
+#pragma omp parallel for schedule(static) num_threads(nThread)
+    for (int i = 0; i < nRow; i++) {
+        for (int t = 0, offset = ptr[i]; t < nThread; t++) {
+            const int n = count[t][i];
+            count[t][i] = offset;
+            offset += n;
+        }
+    }
+    vector<Element> elements(nNnz);
+#pragma omp parallel for schedule(static, 1) num_threads(nThread)
+    for (int t = 0; t < nThread; t++) {
+        const vector<Element> &local = parsed[t];
+        int *cursor = count[t].data();
+        for (size_t i = 0; i < local.size(); i++) elements[cursor[local[i].row]++] = local[i];
+    }
+#pragma omp parallel for schedule(dynamic, 1024) num_threads(nThread)
+    for (int i = 0; i < nRow; i++) {
+        if (ptr[i+1] - ptr[i] > 1) sort(elements.begin() + ptr[i], elements.begin() + ptr[i+1], ColComparator());
+    }
+    return elements;
+}
@@ -30,7 +30,11 @@ struct ColComparator {
 
 string GetBasename (const string &path);
 
-vector<Element> GetElementsFromFile (const string &mtxFile, int &nRow, int &nCol, int &nNnz);
+vector<Element> GetElementsFromFile (const string &mtxFile, int &nRow, int &nCol, int &nNnz, bool *symmetric = NULL);
+bool IsSymmetricBanner (const char *begin, const char *end);
+void ParseMatrixMarketElements (const char *begin, const char *end, vector<Element> &elements);
+// Runtime option given by an environment variable
+string GetEnvOption (const char *name, const string &defaultValue);
 void GetHypergraphPartitioning (int nPart, int nCell, int nNet, int nConst, int *weights, int *costs, int *xpins, int *pins, int *idx2part);
 
 //------------------------------------------
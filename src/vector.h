@@ -1,4 +1,5 @@
 #pragma once
+#include <mpi.h>
 struct Vector {
     int localLength;
     int externalLength;
@@ -7,3 +8,16 @@ struct Vector {
     // internal values
     double *denseInternalValues;
 };
+
+// k vectors stored row major : the values of the row i are values[i * k, i * k + k)
+struct MultiVector {
+    int localLength;
+    int externalLength;
+    int numberOfVectors;
+    double *values;
+    double *sendBuffer;     // [totalNumberOfSend * k] for the halo exchange
+    // persistent halo exchange of the k vectors : the receives, then the sends
+    int numberOfRecvRequests;
+    int numberOfSendRequests;
+    MPI_Request *requests;
+};